@@ -0,0 +1,162 @@
+#include "Reducer.h"
+
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+#include <iostream>
+#include <string_view>
+
+namespace {
+
+const size_t kChunkSize = 4096;
+const size_t kReadBufferSize = 1 << 16;
+
+const size_t kSumLanes = 4;
+
+// kChunkSize int values can't overflow int64, so the loop has no checks.
+// Independent accumulators break the dependency on a single sum
+int64_t SumChunk(const int* values, size_t size) {
+    int64_t sums[kSumLanes] = {};
+    size_t i = 0;
+    for(; i + kSumLanes <= size; i += kSumLanes) {
+        for(size_t lane = 0; lane < kSumLanes; ++lane) {
+            sums[lane] += values[i + lane];
+        }
+    }
+    for(; i < size; ++i) {
+        sums[0] += values[i];
+    }
+    return sums[0] + sums[1] + sums[2] + sums[3];
+}
+
+bool IsSpace(char c) {
+    return c == ' ' || c == '\n' || c == '\t' || c == '\r' || c == '\v' || c == '\f';
+}
+
+std::string ToString(__int128 value) {
+    unsigned __int128 magnitude = value < 0 ? -static_cast<unsigned __int128>(value) : value;
+    char buffer[48];
+    char* end = buffer + sizeof(buffer);
+    char* begin = end;
+    do {
+        *--begin = static_cast<char>('0' + magnitude % 10);
+        magnitude /= 10;
+    } while(magnitude != 0);
+    if(value < 0) {
+        *--begin = '-';
+    }
+    return std::string(begin, end);
+}
+
+} // namespace
+
+Reducer::Reducer(Operation operation)
+    : operation_(operation), narrow_(operation == Operation::kSum ? 0 : 1) {}
+
+void Reducer::Add(std::span<const int> values) {
+    if(operation_ == Operation::kProduct) {
+        Multiply(values);
+        return;
+    }
+    for(size_t begin = 0; begin < values.size() && !is_overflow_; begin += kChunkSize) {
+        size_t size = std::min(kChunkSize, values.size() - begin);
+        Accumulate(SumChunk(values.data() + begin, size));
+    }
+}
+
+void Reducer::Multiply(std::span<const int> values) {
+    // a product of two ints fits int64, so pairs halve the checks
+    size_t i = 0;
+    for(; i + 1 < values.size() && !is_overflow_; i += 2) {
+        if(!is_wide_ && narrow_ == 0) {
+            return;
+        }
+        Accumulate(static_cast<int64_t>(values[i]) * values[i + 1]);
+    }
+    if(i + 1 == values.size() && !is_overflow_) {
+        Accumulate(values[i]);
+    }
+    // an overflowed product is still 0 once a zero factor comes
+    if(is_overflow_ && std::find(values.begin() + i, values.end(), 0) != values.end()) {
+        narrow_ = 0;
+        is_wide_ = false;
+        is_overflow_ = false;
+    }
+}
+
+void Reducer::Accumulate(int64_t value) {
+    bool is_sum = operation_ == Operation::kSum;
+    if(!is_wide_) {
+        int64_t result;
+        bool is_narrow_overflow = is_sum
+            ? __builtin_add_overflow(narrow_, value, &result)
+            : __builtin_mul_overflow(narrow_, value, &result);
+        if(!is_narrow_overflow) {
+            narrow_ = result;
+            return;
+        }
+        wide_ = narrow_;
+        is_wide_ = true;
+    }
+    __int128 wide_value = value;
+    is_overflow_ = is_sum
+        ? __builtin_add_overflow(wide_, wide_value, &wide_)
+        : __builtin_mul_overflow(wide_, wide_value, &wide_);
+}
+
+bool Reducer::IsOverflow() const {
+    return is_overflow_;
+}
+
+std::string Reducer::Result() const {
+    return is_wide_ ? ToString(wide_) : std::to_string(narrow_);
+}
+
+bool ReduceStream(std::FILE* file, Reducer& reducer) {
+    char buffer[kReadBufferSize];
+    int values[kChunkSize];
+    size_t values_count = 0;
+    size_t carry = 0;  // unfinished value from the previous read
+
+    while(true) {
+        size_t read = std::fread(buffer + carry, 1, sizeof(buffer) - carry, file);
+        bool is_end = read == 0;
+        size_t size = carry + read;
+        size_t pos = 0;
+        while(true) {
+            while(pos < size && IsSpace(buffer[pos])) {
+                ++pos;
+            }
+            size_t end = pos;
+            while(end < size && !IsSpace(buffer[end])) {
+                ++end;
+            }
+            if(pos == size || (end == size && !is_end)) {
+                break;
+            }
+            int value = 0;
+            auto [ptr, err] = std::from_chars(buffer + pos, buffer + end, value);
+            if(err != std::errc() || ptr != buffer + end) {
+                std::cerr << "Incorrect value " << std::string_view(buffer + pos, end - pos) << std::endl;
+                return false;
+            }
+            values[values_count++] = value;
+            if(values_count == kChunkSize) {
+                reducer.Add({values, values_count});
+                values_count = 0;
+            }
+            pos = end;
+        }
+        carry = size - pos;
+        if(carry == sizeof(buffer)) {
+            std::cerr << "Value is too long" << std::endl;
+            return false;
+        }
+        std::memmove(buffer, buffer + pos, carry);
+        if(is_end) {
+            break;
+        }
+    }
+    reducer.Add({values, values_count});
+    return !std::ferror(file);
+}
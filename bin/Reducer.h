@@ -0,0 +1,32 @@
+#pragma once
+#include <cstdint>
+#include <cstdio>
+#include <span>
+#include <string>
+
+// Folds values into a sum or a product without keeping them. Works in
+// int64 while it fits and moves to int128 on the first overflow
+class Reducer {
+public:
+    enum class Operation { kSum, kProduct };
+
+    explicit Reducer(Operation operation);
+
+    void Add(std::span<const int> values);
+    bool IsOverflow() const;
+    std::string Result() const;
+
+private:
+    void Multiply(std::span<const int> values);
+    void Accumulate(int64_t value);
+
+    Operation operation_;
+    int64_t narrow_;
+    __int128 wide_ = 0;
+    bool is_wide_ = false;
+    bool is_overflow_ = false;
+};
+
+// Reads whitespace separated integers from file in fixed-size chunks and
+// adds them to reducer. Returns false on a malformed value or a read error
+bool ReduceStream(std::FILE* file, Reducer& reducer);
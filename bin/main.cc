@@ -1,25 +1,76 @@
-#include <functional>
 #include <lib/ArgParser.h>
 
+#include <charconv>
+#include <cstdio>
 #include <iostream>
-#include <numeric>
+#include <string>
+#include <vector>
+
+#include "Reducer.h"
 
 struct Options {
     bool sum = false;
     bool mult = false;
+    bool stream = false;
 };
 
+const size_t kValuesChunkSize = 4096;
+
 int main(int argc, char** argv) {
     Options opt;
-    std::vector<int> values;
+
+    // @file arguments are reduced straight from the file instead of being parsed
+    std::vector<std::string> args;
+    std::vector<std::string> input_files;
+    for(int i = 0; i < argc; ++i) {
+        if(i > 0 && argv[i][0] == '@') {
+            input_files.push_back(argv[i] + 1);
+        } else {
+            args.push_back(argv[i]);
+        }
+    }
 
     ArgumentParser::ArgParser parser("Program");
-    parser.AddIntArgument("N").MultiValue(1).Positional().StoreValues(values);
+    parser.AddIntArgument("N").MultiValue(0).Positional();
     parser.AddFlag("sum", "add args").StoreValue(opt.sum);
     parser.AddFlag("mult", "multiply args").StoreValue(opt.mult);
+    parser.AddFlag("stream", "also read args from stdin, @file args are read the same way").StoreValue(opt.stream);
     parser.AddHelp('h', "help", "Program accumulate arguments");
 
-    if(!parser.Parse(argc, argv)) {
+    // Positional values are folded as they are parsed. --sum or --mult may
+    // come after them, so both folds are kept until the flags are known
+    Reducer sum(Reducer::Operation::kSum);
+    Reducer product(Reducer::Operation::kProduct);
+    int chunk[kValuesChunkSize];
+    size_t chunk_size = 0;
+    bool has_values = false;
+    bool is_parsed = true;
+    auto flush = [&]() {
+        sum.Add({chunk, chunk_size});
+        product.Add({chunk, chunk_size});
+        chunk_size = 0;
+    };
+    for(const ArgumentParser::ParseEvent& event : parser.ParseEvents(args)) {
+        if(event.status != ArgumentParser::ErrorStatus::kNoErrors) {
+            is_parsed = false;
+            if(event.is_fatal) {
+                break;
+            }
+            continue;
+        }
+        if(event.name != "N") {
+            continue;
+        }
+        // the value was already checked by the parser
+        std::from_chars(event.value.data(), event.value.data() + event.value.size(), chunk[chunk_size++]);
+        has_values = true;
+        if(chunk_size == kValuesChunkSize) {
+            flush();
+        }
+    }
+    flush();
+
+    if(!is_parsed && !parser.Help()) {
         std::cout << "Wrong argument" << std::endl;
         std::cout << parser.HelpDescription() << std::endl;
         return 1;
@@ -30,16 +81,43 @@ int main(int argc, char** argv) {
         return 0;
     }
 
-    if(opt.sum) {
-        std::cout << "Result: " << std::accumulate(values.begin(), values.end(), 0) << std::endl;
-    } else if(opt.mult) {
-        std::cout << "Result: " << std::accumulate(values.begin(), values.end(), 1, std::multiplies<int>()) << std::endl;
-    } else {
+    if(!has_values && !opt.stream && input_files.empty()) {
+        std::cout << "Wrong argument" << std::endl;
+        std::cout << parser.HelpDescription() << std::endl;
+        return 1;
+    }
+
+    if(!opt.sum && !opt.mult) {
         std::cout << "No one options had chosen" << std::endl;
         std::cout << parser.HelpDescription();
         return 1;
     }
 
+    Reducer& reducer = opt.sum ? sum : product;
+    for(const std::string& path : input_files) {
+        std::FILE* file = std::fopen(path.c_str(), "r");
+        if(!file) {
+            std::cout << "Can't open " << path << std::endl;
+            return 1;
+        }
+        bool is_read = ReduceStream(file, reducer);
+        std::fclose(file);
+        if(!is_read) {
+            std::cout << "Wrong argument in " << path << std::endl;
+            return 1;
+        }
+    }
+    if(opt.stream && !ReduceStream(stdin, reducer)) {
+        std::cout << "Wrong argument in stdin" << std::endl;
+        return 1;
+    }
+
+    if(reducer.IsOverflow()) {
+        std::cout << "Result doesn't fit into 128 bits" << std::endl;
+        return 1;
+    }
+    std::cout << "Result: " << reducer.Result() << std::endl;
+
     return 0;
 
 }
@@ -1,39 +1,54 @@
 #include "ArgParser.h"
 
+#include <algorithm>
+#include <atomic>
 #include <cstddef>
+#include <cstring>
+#include <exception>
 #include <iostream>
 #include <limits>
 #include <optional>
 #include <string>
 #include <string_view>
+#include <system_error>
+#include <thread>
 
 namespace ArgumentParser {
 
 void SetUsedPosition(std::vector<bool>& used_positions,
                      const std::vector<size_t>& positions) {
   for (size_t i = 0; i < positions.size(); i++) {
-    if (used_positions[positions[i]]) {
+    if (positions[i] >= used_positions.size()) {
+      used_positions.resize(positions[i] + 1);
+    } else if (used_positions[positions[i]]) {
       std::cerr << "Reused argument at position " << positions[i] << std::endl;
     }
     used_positions[positions[i]] = true;
   }
 }
 
+ArgParser::ArgParser(const SchemaImage& image)
+    : name_(image.Name()),
+      help_keyword_(image.HelpKeyword()),
+      arguments_(image.ArgumentsCount()),
+      image_(image) {}
+
+ArgParser::~ArgParser() {
+  for (BaseArgument* argument : arguments_) {
+    delete argument;
+  }
+}
+
 std::vector<size_t> ArgParser::SetValuesForParameter(
-    const std::string_view& name, const std::string& value,
+    size_t argument, const std::string& value,
     const std::vector<std::string>& argv, size_t i) {
-  std::optional<size_t> j_opt = FindArgument(name);
-  if (!j_opt) {
-    std::cerr << "Incorrect parameter name: " << name << std::endl;
-    return {};
-  }
-  size_t j = j_opt.value();
+  const std::string& name = Argument(argument)->GetMetadata().name;
   if (i >= argv.size()) {
     std::cerr << "Incorrect value for parameter " << name << std::endl;
     return {};
   }
   std::vector<size_t> positions =
-      arguments_[j]->ParseValuesFromString(value, argv, i);
+      Argument(argument)->ParseValuesFromString(value, argv, i);
   if (positions.empty()) {
     std::cerr << "Incorrect value for parameter " << name << std::endl;
     return {};
@@ -41,53 +56,138 @@ std::vector<size_t> ArgParser::SetValuesForParameter(
   return positions;
 }
 
-bool ArgParser::Parse(const std::vector<std::string>& args) {
-  bool is_parsing_ok = true;
-  bool is_help_requested = false;
-  std::vector<bool> used_positions(args.size(), false);
-  used_positions[0] = true;
+void ArgParser::SetLimits(const ParseLimits& limits) {
+  limits_ = limits;
+  for (size_t j = 0; j < arguments_.size(); ++j) {
+    if (BaseArgument* argument = CreatedArgument(j)) {
+      argument->SetMaximumArgs(limits_.max_values);
+    }
+  }
+}
+
+const ParseStatistics& ArgParser::Statistics() const {
+  return statistics_;
+}
+
+bool ArgParser::IsWithinLimits(size_t tokens_count, size_t total_bytes,
+                               size_t max_length) const {
+  if (tokens_count > limits_.max_tokens) {
+    std::cerr << "Too many arguments: " << tokens_count << std::endl;
+    return false;
+  }
+  if (total_bytes > limits_.max_total_bytes) {
+    std::cerr << "Arguments are too long: " << total_bytes << " bytes"
+              << std::endl;
+    return false;
+  }
+  if (max_length > limits_.max_value_length) {
+    std::cerr << "Argument is too long: " << max_length << " bytes"
+              << std::endl;
+    return false;
+  }
+  return true;
+}
+
+bool ArgParser::IsWithinLimits(const std::vector<std::string>& args) const {
+  // only the byte budgets need a pass over the tokens
+  if (limits_.max_total_bytes == std::numeric_limits<size_t>::max() &&
+      limits_.max_value_length == std::numeric_limits<size_t>::max()) {
+    return IsWithinLimits(args.size(), 0, 0);
+  }
+  size_t total_bytes = 0;
+  size_t max_length = 0;
+  for (const std::string& arg : args) {
+    total_bytes += arg.size();
+    max_length = std::max(max_length, arg.size());
+  }
+  return IsWithinLimits(args.size(), total_bytes, max_length);
+}
+
+Generator<ParseEvent> ArgParser::ParseEvents(
+    const std::vector<std::string>& args) {
+  return ParseTokens(args, true);
+}
+
+// Callers that checked the limits of args themselves pass check_limits false.
+// Positions taken as values are marked as they are reached, so a caller that
+// stops early doesn't pay for the rest of args
+Generator<ParseEvent> ArgParser::ParseTokens(
+    const std::vector<std::string>& args, bool check_limits) {
+  statistics_ = {};
+  has_reparse_state_ = false;
+  if (args.empty()) {
+    co_return;
+  }
+  if (check_limits && !IsWithinLimits(args)) {
+    co_yield ParseEvent{ParseEvent::kNoArgument, {}, {}, 0, 0,
+                        ErrorStatus::kLimitExceeded, true};
+    co_return;
+  }
+  std::vector<bool> used_positions;
 
-  for (int i = 1; i < args.size(); i++) {
-    if (used_positions[i]) {
+  for (size_t i = 1; i < args.size(); i++) {
+    ++statistics_.tokens;
+    if (i < used_positions.size() && used_positions[i]) {
       continue;
     }
 
     // If starts with --
     if (args[i].compare(0, 2, "--") == 0) {
       size_t delimiter_pos = args[i].find('=');
+      std::string_view name;
+      std::string_view value;
+      size_t value_index = i;
       if (delimiter_pos != std::string::npos) {
-        std::string_view name(args[i].data() + 2, delimiter_pos - 2);
+        name = std::string_view(args[i].data() + 2, delimiter_pos - 2);
         if (delimiter_pos ==
             args[i].length() - 1) {  // if argument ends after delimiter
           std::cerr << "Incorrect value for parameter: " << std::endl;
-          return false;
+          co_yield ParseEvent{ParseEvent::kNoArgument, name, {}, i, i,
+                              ErrorStatus::kParsingError, true};
+          co_return;
         }
-        std::string value = args[i].substr(delimiter_pos + 1);
-        const std::vector<size_t> pos =
-            SetValuesForParameter(name, value, args, i);
-        is_parsing_ok &= pos.size() > 0;
-        SetUsedPosition(used_positions, pos);
-
+        value = std::string_view(args[i]).substr(delimiter_pos + 1);
       } else {
-        std::string_view name(args[i].data() + 2);
-        std::optional<size_t> j_opt = FindArgument(name);
-        if (!j_opt) {
-          std::cerr << "Incorrect parameter name: " << name << std::endl;
-          return false;
+        name = std::string_view(args[i].data() + 2);
+      }
+      std::optional<size_t> j_opt = FindArgument(name, &statistics_.lookups);
+      if (!j_opt) {
+        std::cerr << "Incorrect parameter name: " << name << std::endl;
+        bool is_fatal = delimiter_pos == std::string::npos;
+        co_yield ParseEvent{ParseEvent::kNoArgument, name, value, i, i,
+                            ErrorStatus::kUnknownArgument, is_fatal};
+        if (is_fatal) {
+          co_return;
         }
-        size_t j = j_opt.value();
-        const ArgumentMetadata& meta = arguments_[j]->GetMetadata();
+        continue;
+      }
+      size_t j = j_opt.value();
+      const ArgumentMetadata& meta = Argument(j)->GetMetadata();
+      if (delimiter_pos == std::string::npos) {
         bool is_single_flag = !meta.is_multivalue && meta.is_bitwise;
-        if (meta.name == name && is_single_flag) {
-          arguments_[j]->ParseValuesFromString("true", args, i);
-          used_positions[i] = true;
+        if (is_single_flag) {
+          SaveArgument(j);
+          Argument(j)->ParseValuesFromString("true", args, i);
+          co_yield ParseEvent{j, meta.name, "true", i, i};
           continue;
         }
-        used_positions[i] = true;
-        const std::vector<size_t> pos =
-            SetValuesForParameter(name, args[i + 1], args, i + 1);
-        is_parsing_ok &= pos.size() > 0;
-        SetUsedPosition(used_positions, pos);
+        value_index = i + 1;
+        if (value_index < args.size()) {
+          value = args[value_index];
+        }
+      }
+      SaveArgument(j);
+      const std::vector<size_t> pos =
+          SetValuesForParameter(j, std::string(value), args, value_index);
+      if (pos.empty()) {
+        co_yield ParseEvent{j, meta.name, value, value_index, i,
+                            ErrorStatus::kParsingError};
+        continue;
+      }
+      SetUsedPosition(used_positions, pos);
+      co_yield ParseEvent{j, meta.name, value, pos[0], i};
+      for (size_t k = 1; k < pos.size(); ++k) {
+        co_yield ParseEvent{j, meta.name, args[pos[k]], pos[k], i};
       }
       continue;
     }
@@ -95,194 +195,741 @@ bool ArgParser::Parse(const std::vector<std::string>& args) {
     // If starts with -
     if (args[i][0] == '-') {
       std::string_view names;
-      std::string value;
+      std::string_view value;
       size_t first_value_index_offset = 0;
       size_t delimiter_pos = args[i].find("=");
       if (delimiter_pos != std::string::npos) {
         names = std::string_view(args[i].data() + 1, delimiter_pos - 1);
-        value = args[i].data() + delimiter_pos + 1;
+        value = std::string_view(args[i]).substr(delimiter_pos + 1);
       } else {
         names = args[i].data() + 1;
         if (i + 1 < args.size()) {
           value = args[i + 1];
-          first_value_index_offset = 1;
         }
-        ++first_value_index_offset;
+        first_value_index_offset = 1;
       }
-      for (char c : names) {
-        std::string& name = short_to_long_names_.at(c);
-        std::optional<size_t> j_opt = FindArgument(name);
-        if (!j_opt) {
-          std::cerr << "Incorrect parameter name: " << name << std::endl;
-          return false;
+      for (size_t c = 0; c < names.size(); ++c) {
+        ShortOption& option = FindShortOption(names[c]);
+        if (option.argument == ParseEvent::kNoArgument) {
+          std::cerr << "Incorrect parameter name: " << names[c] << std::endl;
+          co_yield ParseEvent{ParseEvent::kNoArgument, names.substr(c, 1), {},
+                              i, i, ErrorStatus::kUnknownArgument, true};
+          co_return;
         }
-        size_t j = j_opt.value();
-        if (arguments_[j]->GetMetadata().is_bitwise) {
-          arguments_[j]->ParseValuesFromString("true", args, i);
-        } else {
-          const std::vector<size_t> positions =
-              arguments_[j]->ParseValuesFromString(
-                  value, args, i + first_value_index_offset);
-          if (positions.empty()) {
-            std::cerr << "Incorrect value for parameter " << name << std::endl;
-            return false;
-          }
-          SetUsedPosition(used_positions, positions);
+        size_t j = option.argument;
+        if (!option.flag) {
+          option.flag = FlagArgument(j);
+        }
+        SaveArgument(j);
+        if (option.flag) {
+          *option.flag->GetValueStorage() = true;
+          co_yield ParseEvent{j, option.name, "true", i, i};
+          continue;
+        }
+        const ArgumentMetadata& meta = Argument(j)->GetMetadata();
+        const std::string& name = meta.name;
+        if (meta.is_bitwise) {
+          Argument(j)->ParseValuesFromString("true", args, i);
+          co_yield ParseEvent{j, meta.name, "true", i, i};
+          continue;
+        }
+        size_t value_index = i + first_value_index_offset;
+        const std::vector<size_t> positions =
+            value_index < args.size()
+                ? Argument(j)->ParseValuesFromString(std::string(value),
+                                                       args, value_index)
+                : std::vector<size_t>{};
+        if (positions.empty()) {
+          std::cerr << "Incorrect value for parameter " << name << std::endl;
+          co_yield ParseEvent{j, meta.name, value, value_index, i,
+                              ErrorStatus::kParsingError, true};
+          co_return;
+        }
+        SetUsedPosition(used_positions, positions);
+        co_yield ParseEvent{j, meta.name, value, positions[0], i};
+        for (size_t k = 1; k < positions.size(); ++k) {
+          co_yield ParseEvent{j, meta.name, args[positions[k]], positions[k],
+                              i};
         }
       }
-      used_positions[i] = true;
       continue;
     }
-  }
 
-  // parse positional arguments
-  for (size_t k = 0; k < used_positions.size(); ++k) {
-    if (!used_positions[k]) {
-      for (size_t j = 0; j < arguments_.size(); ++j) {
-        if (arguments_[j]->GetMetadata().is_positional) {
-          const std::vector<size_t> positions =
-              arguments_[j]->ParseValuesFromString(args[k], args, k);
-          if (positions.empty()) {
-            std::cerr << "Incorrect value for parameter "
-                      << arguments_[j]->GetMetadata().name << std::endl;
-            return false;
-          }
-          SetUsedPosition(used_positions, positions);
-        }
+    // Options only consume tokens after themselves, so a free token is
+    // positional. Values are applied in command line order: for a positional
+    // also given by name, "app 9 --N=2" gives [9, 2]
+    for (size_t j = 0; j < arguments_.size(); ++j) {
+      if (!IsPositional(j)) {
+        continue;
+      }
+      SaveArgument(j);
+      const ArgumentMetadata& meta = Argument(j)->GetMetadata();
+      const std::vector<size_t> positions =
+          Argument(j)->ParseValuesFromString(args[i], args, i);
+      if (positions.empty()) {
+        std::cerr << "Incorrect value for parameter " << meta.name
+                  << std::endl;
+        co_yield ParseEvent{j, meta.name, args[i], i, i,
+                            ErrorStatus::kParsingError, true};
+        co_return;
       }
+      SetUsedPosition(used_positions, positions);
+      for (size_t k = 0; k < positions.size(); ++k) {
+        co_yield ParseEvent{j, meta.name, args[positions[k]], positions[k],
+                            i};
+      }
+    }
+    if (i >= used_positions.size() || !used_positions[i]) {
+      co_yield ParseEvent{ParseEvent::kNoArgument, {}, args[i], i, i,
+                          ErrorStatus::kParsingError};
     }
   }
+}
+
+bool ArgParser::Parse(const std::vector<std::string>& args) {
+  // reject over-budget input before any per-token work or allocation
+  if (!IsWithinLimits(args)) {
+    return false;
+  }
+  return ParseAndCheck(args, nullptr);
+}
 
-  for (bool b : used_positions) {
-    if (!b) {
+bool ArgParser::ParseAndCheck(const std::vector<std::string>& args,
+                              std::vector<TokenOwner>* owners) {
+  bool is_parsing_ok = true;
+  for (const ParseEvent& event : ParseTokens(args, false)) {
+    if (event.status != ErrorStatus::kNoErrors) {
+      if (event.is_fatal) {
+        return false;
+      }
       is_parsing_ok = false;
-      break;
+      continue;
+    }
+    if (owners) {
+      owners->push_back(
+          {event.argument, event.option_index, event.token_index});
     }
   }
+
   for (size_t i = 0; i < arguments_.size(); ++i) {
-    is_parsing_ok &= arguments_[i]->IsCorrect();
+    is_parsing_ok &= IsArgumentCorrect(i);
   }
-  if (Help()) {
-    return true;
-  }
-  return is_parsing_ok;
+  return Help() || is_parsing_ok;
 }
 
 bool ArgParser::Parse(int argc, char** argv) {
+  // reject over-budget input before copying it
+  if (!IsWithinLimits(argc, 0, 0)) {
+    return false;
+  }
+  size_t length_bound = limits_.max_value_length;
+  if (length_bound < std::numeric_limits<size_t>::max()) {
+    ++length_bound;
+  }
+  size_t total_bytes = 0;
+  size_t max_length = 0;
+  for (int i = 0; i < argc; i++) {
+    size_t length = strnlen(argv[i], length_bound);
+    total_bytes += length;
+    max_length = std::max(max_length, length);
+    if (!IsWithinLimits(argc, total_bytes, max_length)) {
+      return false;
+    }
+  }
   std::vector<std::string> args;
   for (int i = 0; i < argc; i++) {
     args.push_back(argv[i]);
   }
-  return ArgParser::Parse(args);
+  return ParseAndCheck(args, nullptr);
 }
 
-std::optional<size_t> ArgParser::FindArgument(
-    const std::string_view& name) const {
-  for (size_t i = 0; i < arguments_.size(); i++) {
-    if (arguments_[i]->GetMetadata().name == name) {
-      return i;
+std::optional<std::vector<std::string>> ArgParser::Reparse(
+    const std::vector<std::string>& args) {
+  if (!IsWithinLimits(args)) {
+    return std::nullopt;
+  }
+  if (has_reparse_state_ && args == reparse_args_) {
+    return std::vector<std::string>{};
+  }
+  bool had_reparse_state = has_reparse_state_;
+  std::vector<std::string> tokens = args;
+  std::vector<TokenOwner> owners;
+  std::optional<bool> is_parsed;
+  if (had_reparse_state) {
+    is_parsed = ReparseChangedTokens(tokens, owners);
+  }
+  if (!is_parsed) {
+    owners.clear();
+    is_parsed = ReparseAllTokens(tokens, owners);
+  }
+  if (!is_parsed.value()) {
+    has_reparse_state_ = had_reparse_state;
+    return std::nullopt;
+  }
+  reparse_args_ = std::move(tokens);
+  reparse_owners_ = std::move(owners);
+  has_reparse_state_ = true;
+  return TakeChangedArguments();
+}
+
+bool ArgParser::ReparseAllTokens(const std::vector<std::string>& tokens,
+                                 std::vector<TokenOwner>& owners) {
+  saved_arguments_.reserve(arguments_.size());
+  for (size_t j = 0; j < arguments_.size(); ++j) {
+    saved_arguments_.push_back({j, SnapshotArgument(j)});
+  }
+  ResetArguments();
+  if (!ParseAndCheck(tokens, &owners)) {
+    RestoreSavedArguments();
+    return false;
+  }
+  return true;
+}
+
+// Tokens before and after the changed range are the same as in the last
+// Reparse. When the range consists of whole occurrences of single value
+// options that don't occur elsewhere, only those options are reset and
+// parsed again. nullopt means a full walk is needed
+std::optional<bool> ArgParser::ReparseChangedTokens(
+    const std::vector<std::string>& tokens, std::vector<TokenOwner>& owners) {
+  const std::vector<std::string>& previous = reparse_args_;
+  size_t common = std::min(previous.size(), tokens.size());
+  size_t prefix = 0;
+  while (prefix < common && previous[prefix] == tokens[prefix]) {
+    ++prefix;
+  }
+  size_t suffix = 0;
+  while (suffix < common - prefix &&
+         previous[previous.size() - 1 - suffix] ==
+             tokens[tokens.size() - 1 - suffix]) {
+    ++suffix;
+  }
+  // a new program name or a help request is left to the full walk
+  if (prefix == 0 || Help()) {
+    return std::nullopt;
+  }
+  size_t previous_end = previous.size() - suffix;
+  size_t tokens_end = tokens.size() - suffix;
+  // a bare value after the range may be taken by a ranged argument inside
+  // it, or freed for one before it
+  if (tokens_end < tokens.size() && tokens[tokens_end][0] != '-') {
+    return std::nullopt;
+  }
+
+  auto is_changed = [&](const TokenOwner& owner) {
+    return owner.token_index >= prefix && owner.option_index < previous_end;
+  };
+  auto is_ranged = [this](size_t argument) {
+    return IsPositional(argument) ||
+           Argument(argument)->GetMetadata().is_multivalue;
+  };
+  std::vector<size_t> affected;
+  for (const TokenOwner& owner : reparse_owners_) {
+    // an argument that owns the token before the range may continue into it
+    if (owner.token_index == prefix - 1 && is_ranged(owner.argument)) {
+      return std::nullopt;
+    }
+    if (!is_changed(owner)) {
+      continue;
+    }
+    if (owner.option_index < prefix || owner.token_index >= previous_end) {
+      return std::nullopt;
     }
+    affected.push_back(owner.argument);
   }
-  return std::nullopt;
+  std::sort(affected.begin(), affected.end());
+  affected.erase(std::unique(affected.begin(), affected.end()),
+                 affected.end());
+  if (std::any_of(affected.begin(), affected.end(), is_ranged)) {
+    return std::nullopt;
+  }
+
+  is_saving_arguments_ = true;
+  for (size_t j : affected) {
+    SaveArgument(j);
+    Argument(j)->Reset();
+  }
+  std::vector<std::string> changed_tokens{tokens[0]};
+  changed_tokens.insert(changed_tokens.end(), tokens.begin() + prefix,
+                        tokens.begin() + tokens_end);
+  std::vector<TokenOwner> changed_owners;
+  bool is_local = true;
+  for (const ParseEvent& event : ParseTokens(changed_tokens, false)) {
+    if (event.status != ErrorStatus::kNoErrors || is_ranged(event.argument)) {
+      is_local = false;
+      break;
+    }
+    changed_owners.push_back({event.argument,
+                              event.option_index + prefix - 1,
+                              event.token_index + prefix - 1});
+    affected.push_back(event.argument);
+  }
+  is_saving_arguments_ = false;
+  std::sort(affected.begin(), affected.end());
+  affected.erase(std::unique(affected.begin(), affected.end()),
+                 affected.end());
+  // the last occurrence of an option wins, so it must not occur elsewhere
+  for (const TokenOwner& owner : reparse_owners_) {
+    is_local &= is_changed(owner) || !std::binary_search(affected.begin(),
+                                                         affected.end(),
+                                                         owner.argument);
+  }
+  for (size_t j : affected) {
+    is_local = is_local && IsArgumentCorrect(j);
+  }
+  if (!is_local) {
+    RestoreSavedArguments();
+    return std::nullopt;
+  }
+
+  for (const TokenOwner& owner : reparse_owners_) {
+    if (owner.token_index < prefix) {
+      owners.push_back(owner);
+    } else if (owner.option_index >= previous_end) {
+      owners.push_back({owner.argument,
+                        owner.option_index - previous_end + tokens_end,
+                        owner.token_index - previous_end + tokens_end});
+    }
+  }
+  owners.insert(owners.end(), changed_owners.begin(), changed_owners.end());
+  return true;
+}
+
+// Keeps the values of an argument before a Reparse changes it, once per
+// argument
+void ArgParser::SaveArgument(size_t argument) {
+  if (!is_saving_arguments_) {
+    return;
+  }
+  for (const SavedArgument& saved : saved_arguments_) {
+    if (saved.argument == argument) {
+      return;
+    }
+  }
+  saved_arguments_.push_back({argument, SnapshotArgument(argument)});
+}
+
+// nullptr for an argument of a schema image that wasn't created yet, its
+// values are the ones in the image
+BaseArgument* ArgParser::SnapshotArgument(size_t argument) const {
+  BaseArgument* created = CreatedArgument(argument);
+  if (!created) {
+    return nullptr;
+  }
+  BaseArgument* snapshot = created->Clone();
+  snapshot->AssignValues(*created);
+  return snapshot;
+}
+
+void ArgParser::RestoreSavedArguments() {
+  for (const SavedArgument& saved : saved_arguments_) {
+    BaseArgument* created = CreatedArgument(saved.argument);
+    if (saved.values) {
+      created->AssignValues(*saved.values);
+      delete saved.values;
+    } else if (created) {
+      created->Reset();
+    }
+  }
+  saved_arguments_.clear();
+}
+
+// Names of the saved arguments whose values differ from the saved ones, in
+// registration order
+std::vector<std::string> ArgParser::TakeChangedArguments() {
+  std::sort(saved_arguments_.begin(), saved_arguments_.end(),
+            [](const SavedArgument& lhs, const SavedArgument& rhs) {
+              return lhs.argument < rhs.argument;
+            });
+  std::vector<std::string> changed;
+  for (const SavedArgument& saved : saved_arguments_) {
+    BaseArgument* current = CreatedArgument(saved.argument);
+    if (!current) {
+      continue;
+    }
+    BaseArgument* previous =
+        saved.values ? saved.values : image_->CreateArgument(saved.argument);
+    if (!current->HasSameValues(*previous)) {
+      changed.push_back(current->GetMetadata().name);
+    }
+    delete previous;
+  }
+  saved_arguments_.clear();
+  return changed;
+}
+
+void ArgParser::ResetArguments() {
+  for (size_t i = 0; i < arguments_.size(); ++i) {
+    if (BaseArgument* argument = CreatedArgument(i)) {
+      argument->Reset();
+    }
+  }
+}
+
+void ArgParser::CopySchemaTo(ArgParser& other) const {
+  other.name_ = name_;
+  other.help_keyword_ = help_keyword_;
+  other.help_description_ = help_description_;
+  other.limits_ = limits_;
+  other.image_ = image_;
+  for (size_t i = 0; i < arguments_.size(); ++i) {
+    BaseArgument* created = CreatedArgument(i);
+    other.arguments_.emplace_back(created ? created->Clone() : nullptr);
+  }
+  // names and flags of the copy point into its own arguments
+  for (size_t c = 0; c < short_options_.size(); ++c) {
+    size_t argument = short_options_[c].argument;
+    if (argument != ParseEvent::kNoArgument) {
+      other.short_options_[c] = {argument, other.ArgumentName(argument)};
+    }
+  }
+}
+
+namespace {
+
+// Contiguous chunks of a worker, taken from the front by the owner and by
+// idle workers stealing from it
+struct alignas(64) WorkRange {
+  std::atomic<size_t> next{0};
+  size_t end = 0;
+};
+
+const size_t kCommandLinesPerChunk = 64;
+
+}  // namespace
+
+std::vector<bool> ArgParser::ParseMany(
+    std::span<const std::vector<std::string>> command_lines,
+    const std::function<void(size_t, const ArgParser&)>& on_parsed,
+    size_t threads_count) const {
+  size_t chunks_count =
+      (command_lines.size() + kCommandLinesPerChunk - 1) / kCommandLinesPerChunk;
+  if (threads_count == 0) {
+    threads_count = std::max<size_t>(std::thread::hardware_concurrency(), 1);
+  }
+  threads_count = std::max<size_t>(std::min(threads_count, chunks_count), 1);
+
+  std::vector<WorkRange> ranges(threads_count);
+  for (size_t w = 0; w < threads_count; ++w) {
+    ranges[w].next = chunks_count * w / threads_count;
+    ranges[w].end = chunks_count * (w + 1) / threads_count;
+  }
+  std::vector<uint8_t> results(command_lines.size(), false);
+  // the first exception thrown by a worker, rethrown once all are joined
+  std::exception_ptr error;
+  std::atomic<bool> has_error{false};
+
+  auto work = [&](size_t worker) {
+    try {
+      ArgParser parser(name_);
+      CopySchemaTo(parser);
+      for (size_t k = 0; k < threads_count; ++k) {
+        WorkRange& range = ranges[(worker + k) % threads_count];
+        size_t chunk;
+        while (!has_error && (chunk = range.next.fetch_add(1)) < range.end) {
+          size_t end = std::min(command_lines.size(),
+                                (chunk + 1) * kCommandLinesPerChunk);
+          for (size_t i = chunk * kCommandLinesPerChunk; i < end; ++i) {
+            parser.ResetArguments();
+            try {
+              results[i] = parser.Parse(command_lines[i]);
+            } catch (const std::exception& e) {
+              std::cerr << "Command line " << i << ": " << e.what()
+                        << std::endl;
+              results[i] = false;
+            }
+            if (on_parsed) {
+              on_parsed(i, parser);
+            }
+          }
+        }
+      }
+    } catch (...) {
+      if (!has_error.exchange(true)) {
+        error = std::current_exception();
+      }
+    }
+  };
+
+  std::vector<std::thread> threads;
+  try {
+    for (size_t w = 1; w < threads_count; ++w) {
+      threads.emplace_back(work, w);
+    }
+  } catch (const std::system_error& e) {
+    // every worker steals from all ranges, so fewer threads still finish
+    std::cerr << "Can't start worker: " << e.what() << std::endl;
+  }
+  work(0);
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+  if (error) {
+    std::rethrow_exception(error);
+  }
+  return std::vector<bool>(results.begin(), results.end());
+}
+
+// lookups gets the number of name comparisons when not null. Getters pass
+// nothing, so reading a const parser writes no shared state
+std::optional<size_t> ArgParser::FindArgument(const std::string_view& name,
+                                              size_t* lookups) const {
+  size_t comparisons = 0;
+  std::optional<size_t> found;
+  size_t first_registered = 0;
+  if (image_) {
+    ++comparisons;
+    found = image_->Find(name);
+    first_registered = image_->ArgumentsCount();
+  }
+  for (size_t i = first_registered; !found && i < arguments_.size(); i++) {
+    ++comparisons;
+    if (CreatedArgument(i)->GetMetadata().name == name) {
+      found = i;
+    }
+  }
+  if (lookups) {
+    *lookups += comparisons;
+  }
+  return found;
+}
+
+// The first registration of a short name wins, arguments of the schema
+// image come first
+void ArgParser::RegisterShortName(char short_name, size_t argument) {
+  ShortOption& option = short_options_[static_cast<unsigned char>(short_name)];
+  if (short_name == '\0' || option.argument != ParseEvent::kNoArgument ||
+      (image_ && image_->FindShort(short_name))) {
+    return;
+  }
+  option = {argument, ArgumentName(argument)};
+}
+
+// Short names of a schema image are looked up in it on first use
+ArgParser::ShortOption& ArgParser::FindShortOption(char short_name) {
+  ShortOption& option = short_options_[static_cast<unsigned char>(short_name)];
+  if (option.argument == ParseEvent::kNoArgument && image_) {
+    std::optional<size_t> j_opt = image_->FindShort(short_name);
+    if (j_opt) {
+      option = {j_opt.value(), ArgumentName(j_opt.value())};
+    }
+  }
+  return option;
+}
+
+// The argument a bare short flag sets, nullptr if it takes values
+ExactArgument<bool>* ArgParser::FlagArgument(size_t argument) const {
+  const ArgumentMetadata& meta = Argument(argument)->GetMetadata();
+  if (!meta.is_bitwise || meta.is_multivalue) {
+    return nullptr;
+  }
+  return static_cast<ExactArgument<bool>*>(Argument(argument));
+}
+
+// Concurrent readers of a const parser may race to create the same
+// argument, the first one stored is kept
+BaseArgument* ArgParser::Argument(size_t argument) const {
+  BaseArgument* created = CreatedArgument(argument);
+  if (created) {
+    return created;
+  }
+  BaseArgument* fresh = image_->CreateArgument(argument);
+  fresh->SetMaximumArgs(limits_.max_values);
+  if (!arguments_[argument].compare_exchange_strong(
+          created, fresh, std::memory_order_acq_rel,
+          std::memory_order_acquire)) {
+    delete fresh;
+    return created;
+  }
+  return fresh;
+}
+
+// nullptr for an argument of a schema image that wasn't created yet
+BaseArgument* ArgParser::CreatedArgument(size_t argument) const {
+  return arguments_[argument].load(std::memory_order_acquire);
+}
+
+std::string_view ArgParser::ArgumentName(size_t argument) const {
+  BaseArgument* created = CreatedArgument(argument);
+  if (!created) {
+    return image_->String(image_->Argument(argument).name);
+  }
+  return created->GetMetadata().name;
+}
+
+bool ArgParser::IsPositional(size_t argument) const {
+  BaseArgument* created = CreatedArgument(argument);
+  if (!created) {
+    return image_->Argument(argument).flags & kSchemaPositional;
+  }
+  return created->GetMetadata().is_positional;
+}
+
+// An argument that was never created still holds its registration state
+bool ArgParser::IsArgumentCorrect(size_t argument) const {
+  if (BaseArgument* created = CreatedArgument(argument)) {
+    return created->IsCorrect();
+  }
+  const SchemaArgumentRecord& record = image_->Argument(argument);
+  uint64_t args_count =
+      (record.flags & (kSchemaHasDefault | kSchemaBitwise)) ? 1 : 0;
+  return args_count >= record.minimum_args;
+}
+
+std::optional<std::vector<char>> ArgParser::CompileSchema() const {
+  size_t count = arguments_.size();
+  SchemaImageHeader header;
+  std::vector<SchemaArgumentRecord> records(count);
+  std::string strings;
+  // offsets are relative to the string pool until the layout is known
+  auto add_string = [&strings](std::string_view value) {
+    SchemaStringRef ref{static_cast<uint32_t>(strings.size()),
+                        static_cast<uint32_t>(value.size())};
+    strings += value;
+    return ref;
+  };
+
+  uint32_t table_size = 1;
+  while (table_size < 2 * count) {
+    table_size <<= 1;
+  }
+  std::vector<uint32_t> table(table_size, 0);
+
+  header.name = add_string(name_);
+  header.help_keyword = add_string(help_keyword_);
+  for (size_t j = 0; j < count; ++j) {
+    BaseArgument* argument = Argument(j);
+    const ArgumentMetadata& meta = argument->GetMetadata();
+    std::string type_name = argument->GetTypeNameString();
+    if (!IsSchemaImageType(type_name)) {
+      std::cerr << "Argument " << meta.name << " of type " << type_name
+                << " can't be compiled" << std::endl;
+      return std::nullopt;
+    }
+    SchemaArgumentRecord& record = records[j];
+    record.name = add_string(meta.name);
+    record.description = add_string(meta.description);
+    record.type_name = add_string(type_name);
+    record.default_value =
+        add_string(meta.has_default ? argument->GetDefaultValueString() : "");
+    record.minimum_args = meta.minimum_args;
+    record.short_name = meta.short_name;
+    record.flags = (meta.is_positional ? kSchemaPositional : 0) |
+                   (meta.is_multivalue ? kSchemaMultivalue : 0) |
+                   (meta.has_default ? kSchemaHasDefault : 0) |
+                   (meta.is_bitwise ? kSchemaBitwise : 0);
+
+    uint32_t slot = HashArgumentName(meta.name) & (table_size - 1);
+    while (table[slot] != 0) {
+      slot = (slot + 1) & (table_size - 1);
+    }
+    table[slot] = j + 1;
+    // the first registration of a short name wins, as in RegisterShortName
+    unsigned char short_slot = static_cast<unsigned char>(meta.short_name);
+    if (meta.short_name != '\0' && header.short_slots[short_slot] == 0) {
+      header.short_slots[short_slot] = j + 1;
+    }
+  }
+
+  size_t arguments_offset = sizeof(SchemaImageHeader);
+  size_t hash_table_offset =
+      arguments_offset + count * sizeof(SchemaArgumentRecord);
+  size_t strings_offset = hash_table_offset + table_size * sizeof(uint32_t);
+  size_t total_size = strings_offset + strings.size();
+  if (total_size > std::numeric_limits<uint32_t>::max()) {
+    std::cerr << "Schema is too large" << std::endl;
+    return std::nullopt;
+  }
+  header.total_size = total_size;
+  header.arguments_count = count;
+  header.arguments_offset = arguments_offset;
+  header.hash_table_size = table_size;
+  header.hash_table_offset = hash_table_offset;
+  header.strings_offset = strings_offset;
+  header.name.offset += strings_offset;
+  header.help_keyword.offset += strings_offset;
+  for (SchemaArgumentRecord& record : records) {
+    record.name.offset += strings_offset;
+    record.description.offset += strings_offset;
+    record.type_name.offset += strings_offset;
+    record.default_value.offset += strings_offset;
+  }
+
+  std::vector<char> image(total_size);
+  std::memcpy(image.data(), &header, sizeof(header));
+  std::memcpy(image.data() + arguments_offset, records.data(),
+              count * sizeof(SchemaArgumentRecord));
+  std::memcpy(image.data() + hash_table_offset, table.data(),
+              table_size * sizeof(uint32_t));
+  std::memcpy(image.data() + strings_offset, strings.data(), strings.size());
+  return image;
+}
+
+size_t ArgParser::GetValuesCount(const std::string& name) const {
+  std::optional<size_t> i_opt = FindArgument(name);
+  if (!i_opt) {
+    throw std::runtime_error("Argument with name " + name + " not found");
+  }
+  return Argument(i_opt.value())->GetValuesCount();
 }
 
 ExactArgument<std::string>& ArgParser::AddStringArgument(
     const char short_name, const std::string& name, std::string description) {
-  ExactArgument<std::string>* arg =
-      new ExactArgument<std::string>(short_name, name, description);
-  short_to_long_names_.insert(std::make_pair(short_name, name));
-  arguments_.push_back(arg);
-  return *arg;
+  return AddArgument<std::string>(short_name, name, description);
 }
 ExactArgument<std::string>& ArgParser::AddStringArgument(
     const std::string& name, std::string description) {
-  ExactArgument<std::string>* arg =
-      new ExactArgument<std::string>(name, description);
-  arguments_.push_back(arg);
-  return *arg;
+  return AddArgument<std::string>(name, description);
 }
 
 std::string ArgParser::GetStringValue(const std::string& name,
                                       size_t index) const {
-  std::optional<size_t> i_opt = FindArgument(name);
-  if (!i_opt) {
-    throw std::runtime_error("Argument with name " + name + " not found");
-  }
-  ExactArgument<std::string>* arg =
-      dynamic_cast<ExactArgument<std::string>*>(arguments_.at(i_opt.value()));
-  if (arg) {
-    return arg->GetValue(index);
-  } else {
-    throw std::runtime_error("Argument with name " + name + " not found");
-  }
+  return GetValue<std::string>(name, index);
+}
+
+std::span<const std::string> ArgParser::GetStringValues(
+    const std::string& name) const {
+  return GetValues<std::string>(name);
 }
 
 ExactArgument<int>& ArgParser::AddIntArgument(const char short_name,
                                               const std::string& name,
                                               std::string description) {
-  ExactArgument<int>* arg =
-      new ExactArgument<int>(short_name, name, description);
-  short_to_long_names_.insert(std::make_pair(short_name, name));
-  arguments_.push_back(arg);
-  return *arg;
+  return AddArgument<int>(short_name, name, description);
 }
 
 ExactArgument<int>& ArgParser::AddIntArgument(const std::string& name,
                                               std::string description) {
-  ExactArgument<int>* arg = new ExactArgument<int>(name, description);
-  arguments_.push_back(arg);
-  return *arg;
+  return AddArgument<int>(name, description);
 }
 
 int ArgParser::GetIntValue(const std::string& name, size_t index) const {
-  std::optional<size_t> i_opt = FindArgument(name);
-  if (!i_opt) {
-    throw std::runtime_error("Argument with name " + name + " not found");
-  }
-  ExactArgument<int>* arg =
-      dynamic_cast<ExactArgument<int>*>(arguments_.at(i_opt.value()));
-  if (arg) {
-    return arg->GetValue(index);
-  } else {
-    throw std::runtime_error("Argument with name " + name + " not found");
-  }
+  return GetValue<int>(name, index);
+}
+
+std::span<const int> ArgParser::GetIntValues(const std::string& name) const {
+  return GetValues<int>(name);
 }
 
 ExactArgument<bool>& ArgParser::AddFlag(const char short_name,
                                         const std::string& name,
                                         std::string description) {
-  ExactArgument<bool>* arg =
-      new ExactArgument<bool>(short_name, name, description);
-  short_to_long_names_.insert(std::make_pair(short_name, name));
-  arguments_.push_back(arg);
-  return *arg;
+  return AddArgument<bool>(short_name, name, description);
 }
 
 ExactArgument<bool>& ArgParser::AddFlag(const std::string& name,
                                         std::string description) {
-  ExactArgument<bool>* arg = new ExactArgument<bool>(name, description);
-  arguments_.push_back(arg);
-  return *arg;
+  return AddArgument<bool>(name, description);
 }
 
 bool ArgParser::GetFlag(std::string name, size_t index) const {
-  std::optional<size_t> i_opt = FindArgument(name);
-  if (!i_opt) {
-    throw std::runtime_error("Argument with name " + name + " not found");
-  }
-  ExactArgument<bool>* arg =
-      dynamic_cast<ExactArgument<bool>*>(arguments_.at(i_opt.value()));
-  if (arg) {
-    return arg->GetValue(index);
-  } else {
-    throw std::runtime_error("Argument with name " + name + " not found");
-  }
+  return GetValue<bool>(name, index);
 }
 
 void ArgParser::AddHelp(const std::string& name, std::string description) {
   help_keyword_ = name;
   ExactArgument<bool>* arg = new ExactArgument<bool>(name, description);
-  arguments_.push_back(arg);
+  arguments_.emplace_back(arg);
 }
 
 void ArgParser::AddHelp(const char short_name, const std::string& name,
@@ -290,8 +937,8 @@ void ArgParser::AddHelp(const char short_name, const std::string& name,
   help_keyword_ = name;
   ExactArgument<bool>* arg =
       new ExactArgument<bool>(short_name, name, description);
-  short_to_long_names_.insert(std::make_pair(short_name, name));
-  arguments_.push_back(arg);
+  arguments_.emplace_back(arg);
+  RegisterShortName(short_name, arguments_.size() - 1);
 }
 
 bool ArgParser::Help() const {
@@ -301,7 +948,7 @@ bool ArgParser::Help() const {
   }
   size_t i = i_opt.value();
   ExactArgument<bool>* arg =
-      dynamic_cast<ExactArgument<bool>*>(arguments_.at(i));
+      dynamic_cast<ExactArgument<bool>*>(Argument(i));
   if (arg) {
     return arg->GetValue();
   } else {
@@ -319,13 +966,13 @@ const std::string ArgParser::HelpDescription() const {
     help_string += "No description specified\n";
   } else {
     help_string +=
-        arguments_.at(help_index.value())->GetMetadata().description + "\n\n";
+        Argument(help_index.value())->GetMetadata().description + "\n\n";
   }
   for (size_t i = 0; i < arguments_.size(); i++) {
-    if (arguments_[i]->GetMetadata().name == help_keyword_) {
+    if (ArgumentName(i) == help_keyword_) {
       continue;
     }
-    const ArgumentMetadata& metadata = arguments_[i]->GetMetadata();
+    const ArgumentMetadata& metadata = Argument(i)->GetMetadata();
     std::string arg_info;
     if (metadata.short_name != '\0') {
       arg_info += "-";
@@ -335,7 +982,7 @@ const std::string ArgParser::HelpDescription() const {
       arg_info += "     ";
     }
     arg_info += "--" + metadata.name;
-    std::string arg_type = arguments_[i]->GetTypeNameString();
+    std::string arg_type = Argument(i)->GetTypeNameString();
     if (!metadata.is_bitwise && arg_type != "") {
       arg_info += "=<" + arg_type + ">";
     }
@@ -349,13 +996,16 @@ const std::string ArgParser::HelpDescription() const {
           "]";
     }
     if (metadata.has_default) {
-      arg_info += " [default = " + arguments_[i]->GetDefaultValueString() + "]";
+      arg_info += " [default = " + Argument(i)->GetDefaultValueString() + "]";
     }
     help_string += arg_info + "\n";
   }
   help_string += "\n";
+  if (help_index == std::nullopt) {
+    return help_string;
+  }
   const ArgumentMetadata& help_metadata =
-      arguments_.at(help_index.value())->GetMetadata();
+      Argument(help_index.value())->GetMetadata();
   if (help_metadata.short_name != '\0') {
     help_string += "-";
     help_string += help_metadata.short_name;
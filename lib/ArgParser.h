@@ -1,27 +1,142 @@
 #pragma once
+#include <array>
+#include <atomic>
 #include <cstddef>
-#include <map>
+#include <deque>
+#include <functional>
+#include <limits>
+#include <span>
+#include <optional>
 #include <stdexcept>
 #include <string>
 #include <string_view>
 #include <vector>
 
 #include "ArgumentTypes.h"
+#include "Generator.h"
+#include "SchemaImage.h"
 
 namespace ArgumentParser {
 
+// A value applied to an argument while parsing, or an error on a token.
+// Views point into the parsed tokens and the argument names
+struct ParseEvent {
+  static constexpr size_t kNoArgument = std::numeric_limits<size_t>::max();
+
+  size_t argument;  // index in registration order
+  std::string_view name;
+  std::string_view value;
+  size_t token_index;
+  size_t option_index;  // token of the option the value belongs to
+  ErrorStatus status = ErrorStatus::kNoErrors;
+  bool is_fatal = false;  // nothing is parsed after a fatal error
+};
+
+// Budgets for untrusted command lines. Token count and sizes are checked
+// before any per-token work is done
+struct ParseLimits {
+  size_t max_tokens = std::numeric_limits<size_t>::max();
+  size_t max_total_bytes = std::numeric_limits<size_t>::max();
+  size_t max_values = std::numeric_limits<size_t>::max();  // per MultiValue
+  size_t max_value_length = std::numeric_limits<size_t>::max();
+};
+
+// Deterministic work counters since the start of the last parse
+struct ParseStatistics {
+  size_t tokens = 0;   // tokens visited by the parsing loop
+  size_t lookups = 0;  // argument name comparisons
+};
+
 class ArgParser {
   std::string name_;
   std::string help_keyword_;
   std::string help_description_;
 
-  std::vector<BaseArgument*> arguments_;
-  std::map<char, std::string> short_to_long_names_;
+  // Arguments of a parser built from a schema image are created on first
+  // use, also from const getters, so slots are atomic. A deque never moves
+  // them while arguments are registered
+  mutable std::deque<std::atomic<BaseArgument*>> arguments_;
+  // Slot per short name, filled at registration. A bare flag in a cluster
+  // like -abc is set through flag, which keeps the argument rather than its
+  // storage so StoreValue can still rebind it
+  struct ShortOption {
+    size_t argument = ParseEvent::kNoArgument;
+    std::string_view name;
+    ExactArgument<bool>* flag = nullptr;
+  };
+  std::array<ShortOption, 256> short_options_;
+  ParseLimits limits_;
+  ParseStatistics statistics_;
+
+  // Tokens of the last successful Reparse and the argument each consumed
+  // token went to. Only Reparse keeps them, any other parse drops them
+  struct TokenOwner {
+    size_t argument;
+    size_t option_index;
+    size_t token_index;
+  };
+  std::vector<std::string> reparse_args_;
+  std::vector<TokenOwner> reparse_owners_;
+  bool has_reparse_state_ = false;
+
+  // Values of the arguments before the running Reparse changed them, put
+  // back if it fails
+  struct SavedArgument {
+    size_t argument;
+    BaseArgument* values;
+  };
+  std::vector<SavedArgument> saved_arguments_;
+  bool is_saving_arguments_ = false;
+
+  std::optional<SchemaImage> image_;
 
  public:
   explicit ArgParser(std::string name) : name_(name){};
+  // Parses against a precompiled schema without registering arguments. The
+  // image bytes must outlive the parser
+  explicit ArgParser(const SchemaImage& image);
+  ~ArgParser();
+  ArgParser(const ArgParser&) = delete;
+  ArgParser& operator=(const ArgParser&) = delete;
+
   bool Parse(const std::vector<std::string>& args);
   bool Parse(int argc, char** argv);
+  void SetLimits(const ParseLimits& limits);
+  // Position independent image of names, metadata, defaults and help text,
+  // see SchemaImage. nullopt if an argument type can't be stored in it
+  std::optional<std::vector<char>> CompileSchema() const;
+  const ParseStatistics& Statistics() const;
+  // Parses every command line against this schema and returns the results
+  // in input order. Work is spread over threads_count workers (all cores by
+  // default), each with its own copy of the schema; on_parsed is called from
+  // the worker right after its command line is parsed. StoreValue bindings
+  // are not written to
+  std::vector<bool> ParseMany(
+      std::span<const std::vector<std::string>> command_lines,
+      const std::function<void(size_t, const ArgParser&)>& on_parsed = {},
+      size_t threads_count = 0) const;
+  // Applies values lazily, one event per consumed value, so the caller can
+  // stop early. Unlike Parse it doesn't check minimum argument counts.
+  // args must outlive the generator
+  Generator<ParseEvent> ParseEvents(const std::vector<std::string>& args);
+  // Parses a new argument vector and returns names of the arguments whose
+  // values changed, or nullopt if parsing failed, in which case the values
+  // stay as they were. Against the tokens of the previous Reparse only the
+  // options in the changed tokens are parsed again
+  std::optional<std::vector<std::string>> Reparse(
+      const std::vector<std::string>& args);
+
+  // Any type with ArgumentTraits, see ArgumentTypes.h
+  template <typename T>
+  ExactArgument<T>& AddArgument(const char short_name, const std::string& name,
+                                std::string description = "");
+  template <typename T>
+  ExactArgument<T>& AddArgument(const std::string& name,
+                                std::string description = "");
+  template <typename T>
+  T GetValue(const std::string& name, size_t index = 0) const;
+  template <typename T>
+  std::span<const T> GetValues(const std::string& name) const;
 
   ExactArgument<std::string>& AddStringArgument(const char short_name,
                                                 const std::string& name,
@@ -29,6 +144,8 @@ class ArgParser {
   ExactArgument<std::string>& AddStringArgument(const std::string& name,
                                                 std::string description = "");
   std::string GetStringValue(const std::string& name, size_t index = 0) const;
+  // All values at once, valid until the next parse
+  std::span<const std::string> GetStringValues(const std::string& name) const;
 
   ExactArgument<bool>& AddFlag(const char short_name, const std::string& name,
                                std::string description = "");
@@ -42,6 +159,9 @@ class ArgParser {
   ExactArgument<int>& AddIntArgument(const std::string& name,
                                      std::string description = "");
   int GetIntValue(const std::string& name, size_t index = 0) const;
+  std::span<const int> GetIntValues(const std::string& name) const;
+
+  size_t GetValuesCount(const std::string& name) const;
 
   void AddHelp(const std::string& name, std::string description = "");
   void AddHelp(const char short_name, const std::string& name,
@@ -50,10 +170,82 @@ class ArgParser {
   const std::string HelpDescription() const;
 
  private:
-  std::optional<size_t> FindArgument(const std::string_view& name) const;
+  void CopySchemaTo(ArgParser& other) const;
+  void ResetArguments();
+  Generator<ParseEvent> ParseTokens(const std::vector<std::string>& args,
+                                    bool check_limits);
+  bool ParseAndCheck(const std::vector<std::string>& args,
+                     std::vector<TokenOwner>* owners);
+  bool ReparseAllTokens(const std::vector<std::string>& tokens,
+                        std::vector<TokenOwner>& owners);
+  std::optional<bool> ReparseChangedTokens(
+      const std::vector<std::string>& tokens, std::vector<TokenOwner>& owners);
+  void SaveArgument(size_t argument);
+  BaseArgument* SnapshotArgument(size_t argument) const;
+  void RestoreSavedArguments();
+  std::vector<std::string> TakeChangedArguments();
+  BaseArgument* Argument(size_t argument) const;
+  BaseArgument* CreatedArgument(size_t argument) const;
+  std::string_view ArgumentName(size_t argument) const;
+  bool IsPositional(size_t argument) const;
+  bool IsArgumentCorrect(size_t argument) const;
+  std::optional<size_t> FindArgument(const std::string_view& name,
+                                     size_t* lookups = nullptr) const;
+  void RegisterShortName(char short_name, size_t argument);
+  ShortOption& FindShortOption(char short_name);
+  ExactArgument<bool>* FlagArgument(size_t argument) const;
+  template <typename T>
+  ExactArgument<T>& GetExactArgument(const std::string& name) const;
+  bool IsWithinLimits(size_t tokens_count, size_t total_bytes,
+                      size_t max_length) const;
+  bool IsWithinLimits(const std::vector<std::string>& args) const;
   std::vector<size_t> SetValuesForParameter(
-      const std::string_view& name, const std::string& value,
+      size_t argument, const std::string& value,
       const std::vector<std::string>& argv, size_t index);
 };
 
+template <typename T>
+ExactArgument<T>& ArgParser::AddArgument(const char short_name,
+                                         const std::string& name,
+                                         std::string description) {
+  ExactArgument<T>* arg = new ExactArgument<T>(short_name, name, description);
+  arg->SetMaximumArgs(limits_.max_values);
+  arguments_.emplace_back(arg);
+  RegisterShortName(short_name, arguments_.size() - 1);
+  return *arg;
+}
+
+template <typename T>
+ExactArgument<T>& ArgParser::AddArgument(const std::string& name,
+                                         std::string description) {
+  ExactArgument<T>* arg = new ExactArgument<T>(name, description);
+  arg->SetMaximumArgs(limits_.max_values);
+  arguments_.emplace_back(arg);
+  return *arg;
+}
+
+template <typename T>
+T ArgParser::GetValue(const std::string& name, size_t index) const {
+  return GetExactArgument<T>(name).GetValue(index);
+}
+
+template <typename T>
+std::span<const T> ArgParser::GetValues(const std::string& name) const {
+  return GetExactArgument<T>(name).GetValues();
+}
+
+template <typename T>
+ExactArgument<T>& ArgParser::GetExactArgument(const std::string& name) const {
+  std::optional<size_t> i_opt = FindArgument(name);
+  if (!i_opt) {
+    throw std::runtime_error("Argument with name " + name + " not found");
+  }
+  ExactArgument<T>* arg =
+      dynamic_cast<ExactArgument<T>*>(Argument(i_opt.value()));
+  if (!arg) {
+    throw std::runtime_error("Argument with name " + name + " not found");
+  }
+  return *arg;
+}
+
 }  // namespace ArgumentParser
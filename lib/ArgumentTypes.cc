@@ -1,5 +1,6 @@
 #include "ArgumentTypes.h"
 
+#include <algorithm>
 #include <charconv>
 #include <cstddef>
 #include <optional>
@@ -7,57 +8,203 @@
 
 namespace ArgumentParser {
 
-template class ExactArgument<std::string>;
+namespace {
 
-template <>
-std::optional<std::string> ExactArgument<std::string>::ParseSingleValue(
-    const std::string_view& value) {
-  return std::string{value.begin(), value.end()};
+template <typename T>
+std::optional<T> ParseNumber(std::string_view value) {
+  T result{};
+  auto [ptr, err] =
+      std::from_chars(value.data(), value.data() + value.size(), result);
+  if (err != std::errc() || ptr != value.data() + value.size()) {
+    return std::nullopt;
+  }
+  return result;
 }
 
-template <>
-std::string ExactArgument<std::string>::GetTypeNameString() const {
-  return "string";
+template <typename T>
+std::string_view FormatNumber(const T& value,
+                              char (&buffer)[kFormatBufferSize]) {
+  auto [ptr, err] = std::to_chars(buffer, buffer + kFormatBufferSize, value);
+  return std::string_view(buffer, ptr - buffer);
 }
 
-template class ExactArgument<bool>;
+// Splits "250ms" into the number and the unit
+std::pair<std::string_view, std::string_view> SplitUnit(
+    std::string_view value) {
+  size_t unit_pos = value.find_first_not_of("+-0123456789");
+  if (unit_pos == std::string_view::npos) {
+    return {value, {}};
+  }
+  return {value.substr(0, unit_pos), value.substr(unit_pos)};
+}
+
+struct Unit {
+  std::string_view name;
+  uint64_t multiplier;
+};
+
+// Ordered by decreasing size for formatting
+const Unit kByteUnits[] = {
+    {"TiB", 1ull << 40}, {"TB", 1000000000000ull}, {"GiB", 1ull << 30},
+    {"GB", 1000000000ull}, {"MiB", 1ull << 20},    {"MB", 1000000ull},
+    {"KiB", 1ull << 10}, {"KB", 1000ull},          {"B", 1ull},
+};
+
+const Unit kDurationUnits[] = {
+    {"h", 3600000000000ull}, {"m", 60000000000ull}, {"s", 1000000000ull},
+    {"ms", 1000000ull},      {"us", 1000ull},       {"ns", 1ull},
+};
+
+// Writes value with the largest unit that divides it exactly
+template <typename T, size_t N>
+std::string_view FormatWithUnit(T value, const Unit (&units)[N],
+                                char (&buffer)[kFormatBufferSize]) {
+  for (const Unit& unit : units) {
+    T multiplier = static_cast<T>(unit.multiplier);
+    if (value != 0 && value % multiplier == 0) {
+      auto [ptr, err] = std::to_chars(buffer, buffer + kFormatBufferSize,
+                                      value / multiplier);
+      std::copy(unit.name.begin(), unit.name.end(), ptr);
+      return std::string_view(buffer, ptr - buffer + unit.name.size());
+    }
+  }
+  return FormatNumber(value, buffer);
+}
+
+}  // namespace
 
-template <>
-std::optional<bool> ExactArgument<bool>::ParseSingleValue(
-    const std::string_view& value) {
+std::optional<std::string> ArgumentTraits<std::string>::Parse(
+    std::string_view value) {
+  return std::string{value.begin(), value.end()};
+}
+
+std::string_view ArgumentTraits<std::string>::Format(
+    const std::string& value, char (&)[kFormatBufferSize]) {
+  return value;
+}
+
+std::optional<bool> ArgumentTraits<bool>::Parse(std::string_view value) {
   if (value == "1" || value == "true") {
-    args_count++;
     return true;
   } else if (value == "0" || value == "false") {
-    args_count++;
     return false;
   }
-  metadata_.error_status = ErrorStatus::kParsingError;
   return std::nullopt;
 }
 
-template <>
-std::string ExactArgument<bool>::GetTypeNameString() const {
-  return "";
+std::string_view ArgumentTraits<bool>::Format(
+    const bool& value, char (&)[kFormatBufferSize]) {
+  return value ? "true" : "false";
 }
 
-template class ExactArgument<int>;
+std::optional<int> ArgumentTraits<int>::Parse(std::string_view value) {
+  return ParseNumber<int>(value);
+}
 
-template <>
-std::optional<int> ExactArgument<int>::ParseSingleValue(
-    const std::string_view& value) {
-  int result = 0;
-  auto [ptr, err] = std::from_chars(value.begin(), value.end(), result);
-  if (err != std::errc() || ptr != value.end()) {
-    metadata_.error_status = ErrorStatus::kParsingError;
+std::string_view ArgumentTraits<int>::Format(
+    const int& value, char (&buffer)[kFormatBufferSize]) {
+  return FormatNumber(value, buffer);
+}
+
+std::optional<int64_t> ArgumentTraits<int64_t>::Parse(std::string_view value) {
+  return ParseNumber<int64_t>(value);
+}
+
+std::string_view ArgumentTraits<int64_t>::Format(
+    const int64_t& value, char (&buffer)[kFormatBufferSize]) {
+  return FormatNumber(value, buffer);
+}
+
+std::optional<uint64_t> ArgumentTraits<uint64_t>::Parse(
+    std::string_view value) {
+  return ParseNumber<uint64_t>(value);
+}
+
+std::string_view ArgumentTraits<uint64_t>::Format(
+    const uint64_t& value, char (&buffer)[kFormatBufferSize]) {
+  return FormatNumber(value, buffer);
+}
+
+std::optional<double> ArgumentTraits<double>::Parse(std::string_view value) {
+  return ParseNumber<double>(value);
+}
+
+std::string_view ArgumentTraits<double>::Format(
+    const double& value, char (&buffer)[kFormatBufferSize]) {
+  return FormatNumber(value, buffer);
+}
+
+std::optional<float> ArgumentTraits<float>::Parse(std::string_view value) {
+  return ParseNumber<float>(value);
+}
+
+std::string_view ArgumentTraits<float>::Format(
+    const float& value, char (&buffer)[kFormatBufferSize]) {
+  return FormatNumber(value, buffer);
+}
+
+std::optional<ByteSize> ArgumentTraits<ByteSize>::Parse(
+    std::string_view value) {
+  auto [number, unit_name] = SplitUnit(value);
+  std::optional<uint64_t> count = ParseNumber<uint64_t>(number);
+  if (!count) {
     return std::nullopt;
   }
-  return result;
+  if (unit_name.empty()) {
+    return ByteSize{*count};
+  }
+  for (const Unit& unit : kByteUnits) {
+    if (unit.name == unit_name) {
+      if (*count > std::numeric_limits<uint64_t>::max() / unit.multiplier) {
+        return std::nullopt;
+      }
+      return ByteSize{*count * unit.multiplier};
+    }
+  }
+  return std::nullopt;
+}
+
+std::string_view ArgumentTraits<ByteSize>::Format(
+    const ByteSize& value, char (&buffer)[kFormatBufferSize]) {
+  return FormatWithUnit(value.bytes, kByteUnits, buffer);
+}
+
+std::optional<Duration> ArgumentTraits<Duration>::Parse(
+    std::string_view value) {
+  auto [number, unit_name] = SplitUnit(value);
+  std::optional<int64_t> count = ParseNumber<int64_t>(number);
+  if (!count) {
+    return std::nullopt;
+  }
+  for (const Unit& unit : kDurationUnits) {
+    if (unit.name == unit_name) {
+      int64_t multiplier = static_cast<int64_t>(unit.multiplier);
+      if (*count > std::numeric_limits<int64_t>::max() / multiplier ||
+          *count < std::numeric_limits<int64_t>::min() / multiplier) {
+        return std::nullopt;
+      }
+      return Duration{*count * multiplier};
+    }
+  }
+  return std::nullopt;
 }
 
-template <>
-std::string ExactArgument<int>::GetTypeNameString() const {
-  return "int";
+std::string_view ArgumentTraits<Duration>::Format(
+    const Duration& value, char (&buffer)[kFormatBufferSize]) {
+  if (value.count() == 0) {
+    return "0s";
+  }
+  return FormatWithUnit(value.count(), kDurationUnits, buffer);
 }
 
+template class ExactArgument<std::string>;
+template class ExactArgument<bool>;
+template class ExactArgument<int>;
+template class ExactArgument<int64_t>;
+template class ExactArgument<uint64_t>;
+template class ExactArgument<double>;
+template class ExactArgument<float>;
+template class ExactArgument<ByteSize>;
+template class ExactArgument<Duration>;
+
 }  // namespace ArgumentParser
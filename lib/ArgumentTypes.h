@@ -1,14 +1,121 @@
 #pragma once
+#include <chrono>
+#include <concepts>
+#include <cstddef>
 #include <cstdint>
+#include <limits>
 #include <optional>
-#include <sstream>
+#include <span>
 #include <string>
+#include <string_view>
 #include <type_traits>
+#include <utility>
 #include <vector>
 
 namespace ArgumentParser {
 
-enum class ErrorStatus { kNoErrors, kTooFewArguments, kParsingError };
+enum class ErrorStatus {
+  kNoErrors,
+  kTooFewArguments,
+  kParsingError,
+  kLimitExceeded,
+  kUnknownArgument
+};
+
+// Amount of bytes written as 4GiB, 512KB or 100
+struct ByteSize {
+  uint64_t bytes = 0;
+
+  bool operator==(const ByteSize&) const = default;
+};
+
+// Time interval written as 250ms, 10s or 2h
+using Duration = std::chrono::nanoseconds;
+
+const size_t kFormatBufferSize = 64;
+
+// Conversion between a value type and its command line text. A type becomes
+// usable with ExactArgument by specializing ArgumentTraits with
+//   static constexpr const char* kTypeName;
+//   static std::optional<T> Parse(std::string_view value);
+//   static std::string_view Format(const T& value,
+//                                  char (&buffer)[kFormatBufferSize]);
+// Built-in conversions use from_chars/to_chars: no locale, no streams and no
+// heap allocations
+template <typename T>
+struct ArgumentTraits;
+
+template <>
+struct ArgumentTraits<std::string> {
+  static constexpr const char* kTypeName = "string";
+  static std::optional<std::string> Parse(std::string_view value);
+  static std::string_view Format(const std::string& value,
+                                 char (&buffer)[kFormatBufferSize]);
+};
+
+template <>
+struct ArgumentTraits<bool> {
+  static constexpr const char* kTypeName = "";
+  static std::optional<bool> Parse(std::string_view value);
+  static std::string_view Format(const bool& value,
+                                 char (&buffer)[kFormatBufferSize]);
+};
+
+template <>
+struct ArgumentTraits<int> {
+  static constexpr const char* kTypeName = "int";
+  static std::optional<int> Parse(std::string_view value);
+  static std::string_view Format(const int& value,
+                                 char (&buffer)[kFormatBufferSize]);
+};
+
+template <>
+struct ArgumentTraits<int64_t> {
+  static constexpr const char* kTypeName = "int64";
+  static std::optional<int64_t> Parse(std::string_view value);
+  static std::string_view Format(const int64_t& value,
+                                 char (&buffer)[kFormatBufferSize]);
+};
+
+template <>
+struct ArgumentTraits<uint64_t> {
+  static constexpr const char* kTypeName = "uint64";
+  static std::optional<uint64_t> Parse(std::string_view value);
+  static std::string_view Format(const uint64_t& value,
+                                 char (&buffer)[kFormatBufferSize]);
+};
+
+template <>
+struct ArgumentTraits<double> {
+  static constexpr const char* kTypeName = "double";
+  static std::optional<double> Parse(std::string_view value);
+  static std::string_view Format(const double& value,
+                                 char (&buffer)[kFormatBufferSize]);
+};
+
+template <>
+struct ArgumentTraits<float> {
+  static constexpr const char* kTypeName = "float";
+  static std::optional<float> Parse(std::string_view value);
+  static std::string_view Format(const float& value,
+                                 char (&buffer)[kFormatBufferSize]);
+};
+
+template <>
+struct ArgumentTraits<ByteSize> {
+  static constexpr const char* kTypeName = "size";
+  static std::optional<ByteSize> Parse(std::string_view value);
+  static std::string_view Format(const ByteSize& value,
+                                 char (&buffer)[kFormatBufferSize]);
+};
+
+template <>
+struct ArgumentTraits<Duration> {
+  static constexpr const char* kTypeName = "duration";
+  static std::optional<Duration> Parse(std::string_view value);
+  static std::string_view Format(const Duration& value,
+                                 char (&buffer)[kFormatBufferSize]);
+};
 
 struct ArgumentMetadata {
   std::string name;
@@ -17,6 +124,7 @@ struct ArgumentMetadata {
 
   bool has_default = false;
   uint64_t minimum_args = 1;
+  uint64_t maximum_args = std::numeric_limits<uint64_t>::max();
   bool is_stored_outside = false;
   bool is_positional = false;
   bool is_multivalue = false;
@@ -34,6 +142,16 @@ class BaseArgument {
       const std::string& first_value, const std::vector<std::string>& argv,
       size_t index) = 0;
   virtual bool IsCorrect() = 0;
+  virtual void Reset() = 0;
+  virtual void SetMaximumArgs(uint64_t maximum_args) = 0;
+  virtual size_t GetValuesCount() const = 0;
+  // Same schema and defaults with own storage, StoreValue bindings are not
+  // shared with the copy
+  virtual BaseArgument* Clone() const = 0;
+  // Values and parse state of an argument with the same schema, written
+  // through this argument's storage
+  virtual void AssignValues(const BaseArgument& other) = 0;
+  virtual bool HasSameValues(const BaseArgument& other) const = 0;
   virtual ~BaseArgument() = default;
 };
 
@@ -42,7 +160,11 @@ class ExactArgument : public BaseArgument {
   ArgumentMetadata metadata_;
   T* value_;
   std::vector<T>* multi_values_;
+  T default_value_{};
   uint64_t args_count;
+  // false once the storage is bound with StoreValue/StoreValues
+  bool owns_value_ = true;
+  bool owns_values_ = true;
 
  public:
   ExactArgument(const char short_name, const std::string& name,
@@ -55,11 +177,8 @@ class ExactArgument : public BaseArgument {
     metadata_.is_bitwise = std::is_same<bool, T>::value;
     if (metadata_.is_bitwise) {
       args_count = 1;
-      value_ = new T{};
-      *value_ = false;
-    } else {
-      value_ = new T{};
     }
+    value_ = new T{};
   }
   ExactArgument(const std::string& name, std::string& description) {
     metadata_.name = name;
@@ -69,26 +188,31 @@ class ExactArgument : public BaseArgument {
     metadata_.is_bitwise = std::is_same<bool, T>::value;
     if (metadata_.is_bitwise) {
       args_count = 1;
-      value_ = new T{};
-      *value_ = false;
-    } else {
-      value_ = new T{};
     }
+    value_ = new T{};
   }
   const ArgumentMetadata& GetMetadata() const override {
     return metadata_;
   }
 
-  std::optional<T> ParseSingleValue(const std::string_view& value);
+  std::optional<T> ParseSingleValue(const std::string_view& value) {
+    std::optional<T> result = ArgumentTraits<T>::Parse(value);
+    if (!result) {
+      metadata_.error_status = ErrorStatus::kParsingError;
+    }
+    return result;
+  }
 
-  std::string GetTypeNameString() const override;  // maybe typeid
+  std::string GetTypeNameString() const override {
+    return ArgumentTraits<T>::kTypeName;
+  }
 
   std::string GetDefaultValueString() const override {
-    std::ostringstream os;
-    if (metadata_.has_default) {
-      os << *value_;
+    if (!metadata_.has_default) {
+      return "";
     }
-    return os.str();
+    char buffer[kFormatBufferSize];
+    return std::string(ArgumentTraits<T>::Format(default_value_, buffer));
   }
 
   std::vector<size_t> ParseValuesFromString(
@@ -100,19 +224,27 @@ class ExactArgument : public BaseArgument {
       return {};
     }
     if (!metadata_.is_multivalue && val) {
-      *value_ = val.value();
+      *value_ = std::move(val.value());
       args_count = 1;
       return std::vector{index};
     }
+    if (args_count >= metadata_.maximum_args) {
+      metadata_.error_status = ErrorStatus::kLimitExceeded;
+      return {};
+    }
     std::vector<size_t> used_indices;
     used_indices.push_back(index);
-    multi_values_->push_back(val.value());
+    multi_values_->push_back(std::move(val.value()));
     ++args_count;
     ++index;
     while (index < argv.size() && argv[index][0] != '-') {
+      if (args_count >= metadata_.maximum_args) {
+        metadata_.error_status = ErrorStatus::kLimitExceeded;
+        return {};
+      }
       val = ParseSingleValue(argv[index]);
       if (val) {
-        multi_values_->push_back(val.value());
+        multi_values_->push_back(std::move(val.value()));
         used_indices.push_back(index);
         ++args_count;
         ++index;
@@ -133,11 +265,69 @@ class ExactArgument : public BaseArgument {
     return true;
   }
 
+  // Brings the argument back to the state it had right after registration
+  void Reset() override {
+    metadata_.error_status = ErrorStatus::kNoErrors;
+    args_count = (metadata_.has_default || metadata_.is_bitwise) ? 1 : 0;
+    if (metadata_.is_multivalue) {
+      multi_values_->clear();
+      if (metadata_.has_default) {
+        multi_values_->push_back(default_value_);
+      }
+    } else {
+      *value_ = metadata_.has_default ? default_value_ : T{};
+    }
+  }
+
+  BaseArgument* Clone() const override {
+    std::string description = metadata_.description;
+    ExactArgument* copy =
+        new ExactArgument(metadata_.short_name, metadata_.name, description);
+    copy->metadata_ = metadata_;
+    copy->metadata_.is_stored_outside = false;
+    copy->default_value_ = default_value_;
+    if (metadata_.is_multivalue) {
+      delete copy->value_;
+      copy->value_ = nullptr;
+      copy->multi_values_ = new std::vector<T>;
+    }
+    copy->Reset();
+    return copy;
+  }
+
+  void AssignValues(const BaseArgument& other) override {
+    const ExactArgument& source = static_cast<const ExactArgument&>(other);
+    metadata_.error_status = source.metadata_.error_status;
+    args_count = source.args_count;
+    if (metadata_.is_multivalue) {
+      *multi_values_ = *source.multi_values_;
+    } else {
+      *value_ = *source.value_;
+    }
+  }
+
+  bool HasSameValues(const BaseArgument& other) const override {
+    if constexpr (std::equality_comparable<T>) {
+      const ExactArgument& source = static_cast<const ExactArgument&>(other);
+      if (metadata_.is_multivalue) {
+        return *multi_values_ == *source.multi_values_;
+      }
+      return *value_ == *source.value_;
+    } else {
+      return false;
+    }
+  }
+
+  void SetMaximumArgs(uint64_t maximum_args) override {
+    metadata_.maximum_args = maximum_args;
+  }
+
   ExactArgument& Default(const T& default_value) {
     metadata_.has_default = true;
+    default_value_ = default_value;
     args_count = 1;
     if (metadata_.is_multivalue) {
-      (*multi_values_)[0] = default_value;
+      multi_values_->assign(1, default_value);
     } else {
       *value_ = default_value;
     }
@@ -145,13 +335,20 @@ class ExactArgument : public BaseArgument {
   }
   ExactArgument& StoreValue(T& value) {
     metadata_.is_stored_outside = true;
+    if (owns_value_) {
+      delete value_;
+    }
     value_ = &value;
+    owns_value_ = false;
     return *this;
   }
   ExactArgument& StoreValues(std::vector<T>& values) {
     metadata_.is_stored_outside = true;
-    delete multi_values_;
+    if (owns_values_) {
+      delete multi_values_;
+    }
     multi_values_ = &values;
+    owns_values_ = false;
     return *this;
   }
   ExactArgument& MultiValue(size_t minimum_args = 1) {
@@ -160,9 +357,15 @@ class ExactArgument : public BaseArgument {
     }
     metadata_.is_multivalue = true;
     metadata_.minimum_args = minimum_args;
-    multi_values_ = new std::vector<T>;
-    delete value_;
+    // a vector bound with StoreValues before is kept
+    if (!multi_values_) {
+      multi_values_ = new std::vector<T>;
+    }
+    if (owns_value_) {
+      delete value_;
+    }
     value_ = nullptr;
+    owns_value_ = true;
     return *this;
   }
   ExactArgument& Positional() {
@@ -171,12 +374,11 @@ class ExactArgument : public BaseArgument {
   }
 
   ~ExactArgument() override {
-    if (!metadata_.is_stored_outside) {
-      if (metadata_.is_multivalue) {
-        delete multi_values_;
-      } else {
-        delete value_;
-      }
+    if (owns_value_) {
+      delete value_;
+    }
+    if (owns_values_) {
+      delete multi_values_;
     }
   }
   T GetValue(size_t index = 0) {
@@ -185,6 +387,22 @@ class ExactArgument : public BaseArgument {
     }
     return *value_;
   }
+  // Contiguous view of the parsed values, not available for flags since
+  // std::vector<bool> is packed
+  std::span<const T> GetValues() const
+    requires(!std::is_same_v<T, bool>)
+  {
+    if (metadata_.is_multivalue) {
+      return *multi_values_;
+    }
+    return {value_, static_cast<size_t>(args_count)};
+  }
+  // Single value storage, nullptr for MultiValue
+  T* GetValueStorage() { return value_; }
+  // 0 for a single value argument that was neither set nor has a default
+  size_t GetValuesCount() const override {
+    return metadata_.is_multivalue ? multi_values_->size() : args_count;
+  }
   ExactArgument(const ExactArgument&) = delete;
   ExactArgument& operator=(const ExactArgument&) = delete;
 };
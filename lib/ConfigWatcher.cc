@@ -0,0 +1,109 @@
+#include "ConfigWatcher.h"
+
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstddef>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+
+namespace ArgumentParser {
+
+std::optional<std::vector<std::string>> ReadArgumentsFile(
+    const std::string& path) {
+  std::ifstream file(path);
+  if (!file) {
+    std::cerr << "Can't open option file " << path << std::endl;
+    return std::nullopt;
+  }
+  return std::vector<std::string>{std::istream_iterator<std::string>(file),
+                                  std::istream_iterator<std::string>()};
+}
+
+FileWatcher::FileWatcher(const std::string& path,
+                         std::function<void()> on_change)
+    : on_change_(std::move(on_change)) {
+  size_t slash_pos = path.rfind('/');
+  if (slash_pos == std::string::npos) {
+    directory_ = ".";
+    file_name_ = path;
+  } else {
+    directory_ = slash_pos == 0 ? "/" : path.substr(0, slash_pos);
+    file_name_ = path.substr(slash_pos + 1);
+  }
+
+  inotify_fd_ = inotify_init1(IN_CLOEXEC);
+  stop_fd_ = eventfd(0, EFD_CLOEXEC);
+  if (inotify_fd_ < 0 || stop_fd_ < 0 ||
+      inotify_add_watch(inotify_fd_, directory_.c_str(),
+                        IN_CLOSE_WRITE | IN_MOVED_TO) < 0) {
+    std::cerr << "Can't watch option file " << path << std::endl;
+    return;
+  }
+  thread_ = std::thread(&FileWatcher::Run, this);
+}
+
+FileWatcher::~FileWatcher() {
+  Stop();
+  if (inotify_fd_ >= 0) {
+    close(inotify_fd_);
+  }
+  if (stop_fd_ >= 0) {
+    close(stop_fd_);
+  }
+}
+
+void FileWatcher::Stop() {
+  if (thread_.joinable()) {
+    uint64_t one = 1;
+    write(stop_fd_, &one, sizeof(one));
+    thread_.join();
+  }
+}
+
+bool FileWatcher::IsWatching() const {
+  return thread_.joinable();
+}
+
+void FileWatcher::Run() {
+  alignas(inotify_event) char buffer[4096];
+  pollfd fds[2] = {{inotify_fd_, POLLIN, 0}, {stop_fd_, POLLIN, 0}};
+  while (true) {
+    if (poll(fds, 2, -1) < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      std::cerr << "Stopped watching option file " << file_name_ << std::endl;
+      return;
+    }
+    if (fds[1].revents & POLLIN) {
+      return;
+    }
+    if (!(fds[0].revents & POLLIN)) {
+      continue;
+    }
+    ssize_t length = read(inotify_fd_, buffer, sizeof(buffer));
+    if (length <= 0) {
+      continue;
+    }
+    bool is_changed = false;
+    for (ssize_t offset = 0; offset < length;) {
+      const inotify_event* event =
+          reinterpret_cast<const inotify_event*>(buffer + offset);
+      if (event->len > 0 && file_name_ == event->name) {
+        is_changed = true;
+      }
+      offset += sizeof(inotify_event) + event->len;
+    }
+    // a burst of events is applied as a single reload
+    if (is_changed) {
+      on_change_();
+    }
+  }
+}
+
+}  // namespace ArgumentParser
@@ -0,0 +1,213 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "ArgParser.h"
+
+namespace ArgumentParser {
+
+// Reads whitespace separated arguments from an option (response) file
+std::optional<std::vector<std::string>> ReadArgumentsFile(
+    const std::string& path);
+
+// Calls on_change from a background thread every time the file is rewritten
+// or replaced. Watches the parent directory, so editors that save through
+// rename are noticed as well
+class FileWatcher {
+  std::string directory_;
+  std::string file_name_;
+  std::function<void()> on_change_;
+  int inotify_fd_ = -1;
+  int stop_fd_ = -1;
+  std::thread thread_;
+
+ public:
+  FileWatcher(const std::string& path, std::function<void()> on_change);
+  ~FileWatcher();
+  bool IsWatching() const;
+  // Joins the background thread, on_change is not called after it returns
+  void Stop();
+
+  FileWatcher(const FileWatcher&) = delete;
+  FileWatcher& operator=(const FileWatcher&) = delete;
+
+ private:
+  void Run();
+};
+
+// Keeps an immutable Config parsed from an option file and republishes it
+// whenever the file changes. The schema callback registers arguments and
+// binds them to the fields of a fresh Config with StoreValue/StoreValues.
+// Readers get the current snapshot without locking and keep it alive for as
+// long as they hold the Snapshot, which must not outlive the watcher.
+//
+// Replaced configs are freed with epoch based reclamation. A reader pins the
+// epoch it started in by incrementing the counter of that epoch's parity.
+// A reload moves the epoch forward only when nobody is pinned in the epoch
+// before the current one, so a config replaced in epoch E is unreachable
+// once the epoch is E + 2. A Snapshot held for long therefore delays freeing
+// of every config replaced after it was taken
+template <typename Config>
+class ConfigWatcher {
+ public:
+  using Schema = std::function<void(ArgParser&, Config&)>;
+
+  class Snapshot {
+    const Config* config_;
+    std::atomic<uint64_t>* readers_;
+
+   public:
+    Snapshot(const Config* config, std::atomic<uint64_t>* readers)
+        : config_(config), readers_(readers) {}
+    Snapshot(Snapshot&& other) noexcept
+        : config_(other.config_), readers_(std::exchange(other.readers_,
+                                                         nullptr)) {}
+    Snapshot& operator=(Snapshot&& other) noexcept {
+      if (this != &other) {
+        Release();
+        config_ = other.config_;
+        readers_ = std::exchange(other.readers_, nullptr);
+      }
+      return *this;
+    }
+    ~Snapshot() {
+      Release();
+    }
+
+    const Config& operator*() const {
+      return *config_;
+    }
+    const Config* operator->() const {
+      return config_;
+    }
+    const Config* get() const {
+      return config_;
+    }
+
+    Snapshot(const Snapshot&) = delete;
+    Snapshot& operator=(const Snapshot&) = delete;
+
+   private:
+    void Release() {
+      if (readers_) {
+        readers_->fetch_sub(1);
+      }
+    }
+  };
+
+ private:
+  struct RetiredConfig {
+    const Config* config;
+    uint64_t epoch;
+  };
+
+  std::string name_;
+  std::string path_;
+  Schema schema_;
+  // Epoch and reader counters use sequentially consistent operations: the
+  // reclamation argument relies on a single order of the pin, the epoch
+  // check and the pointer load against the publish and the epoch advance
+  std::atomic<const Config*> snapshot_;
+  std::atomic<uint64_t> epoch_{0};
+  mutable std::atomic<uint64_t> readers_[2] = {};
+  std::vector<RetiredConfig> retired_;
+  std::atomic<uint64_t> version_{0};
+  std::mutex reload_mutex_;
+  FileWatcher watcher_;
+
+ public:
+  ConfigWatcher(std::string name, std::string path, Schema schema)
+      : name_(std::move(name)),
+        path_(std::move(path)),
+        schema_(std::move(schema)),
+        snapshot_(new Config()),
+        watcher_(path_, [this] { Reload(); }) {
+    Reload();
+  }
+
+  ~ConfigWatcher() {
+    watcher_.Stop();
+    for (const RetiredConfig& retired : retired_) {
+      delete retired.config;
+    }
+    delete snapshot_.load();
+  }
+
+  // Lock-free, retries only while a reload moves the epoch forward
+  Snapshot Get() const {
+    while (true) {
+      uint64_t epoch = epoch_.load();
+      std::atomic<uint64_t>& readers = readers_[epoch & 1];
+      readers.fetch_add(1);
+      if (epoch_.load() == epoch) {
+        return Snapshot(snapshot_.load(), &readers);
+      }
+      readers.fetch_sub(1);
+    }
+  }
+
+  // Number of successfully published snapshots, 0 until the first one
+  uint64_t Version() const {
+    return version_.load(std::memory_order_acquire);
+  }
+
+  bool IsWatching() const {
+    return watcher_.IsWatching();
+  }
+
+  // Re-reads the file and publishes a new snapshot if it parses. On failure
+  // the previous snapshot stays current. Replaced snapshots are freed here
+  // once no reader can hold them
+  bool Reload() {
+    std::lock_guard<std::mutex> lock(reload_mutex_);
+    std::optional<std::vector<std::string>> args = ReadArgumentsFile(path_);
+    if (!args) {
+      return false;
+    }
+    args->insert(args->begin(), name_);
+    std::unique_ptr<Config> config = std::make_unique<Config>();
+    ArgParser parser(name_);
+    schema_(parser, *config);
+    if (!parser.Parse(*args)) {
+      return false;
+    }
+    const Config* replaced = snapshot_.exchange(config.release());
+    retired_.push_back({replaced, epoch_.load()});
+    version_.fetch_add(1, std::memory_order_release);
+    ReclaimRetired();
+    return true;
+  }
+
+  ConfigWatcher(const ConfigWatcher&) = delete;
+  ConfigWatcher& operator=(const ConfigWatcher&) = delete;
+
+ private:
+  // Called under reload_mutex_, the only place the epoch moves
+  void ReclaimRetired() {
+    for (int step = 0; step < 2; ++step) {
+      uint64_t epoch = epoch_.load();
+      if (readers_[(epoch - 1) & 1].load() != 0) {
+        break;
+      }
+      epoch_.store(epoch + 1);
+    }
+    uint64_t epoch = epoch_.load();
+    std::erase_if(retired_, [epoch](const RetiredConfig& retired) {
+      if (retired.epoch + 2 > epoch) {
+        return false;
+      }
+      delete retired.config;
+      return true;
+    });
+  }
+};
+
+}  // namespace ArgumentParser
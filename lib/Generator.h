@@ -0,0 +1,113 @@
+#pragma once
+#include <coroutine>
+#include <cstddef>
+#include <exception>
+#include <iterator>
+#include <memory>
+#include <utility>
+
+namespace ArgumentParser {
+
+// Minimal lazy generator: the coroutine runs only when the caller advances
+// the iterator, so destroying it early stops the work
+template <typename T>
+class Generator {
+ public:
+  struct promise_type {
+    const T* value_ = nullptr;
+    std::exception_ptr exception_;
+
+    Generator get_return_object() {
+      return Generator{Handle::from_promise(*this)};
+    }
+    std::suspend_always initial_suspend() noexcept {
+      return {};
+    }
+    std::suspend_always final_suspend() noexcept {
+      return {};
+    }
+    std::suspend_always yield_value(const T& value) noexcept {
+      value_ = std::addressof(value);
+      return {};
+    }
+    void return_void() noexcept {}
+    void unhandled_exception() {
+      exception_ = std::current_exception();
+    }
+  };
+
+ private:
+  using Handle = std::coroutine_handle<promise_type>;
+  Handle handle_;
+
+  explicit Generator(Handle handle) : handle_(handle) {}
+
+  static void Resume(Handle handle) {
+    handle.resume();
+    if (handle.promise().exception_) {
+      std::rethrow_exception(handle.promise().exception_);
+    }
+  }
+
+ public:
+  class Iterator {
+    Handle handle_;
+
+   public:
+    using iterator_category = std::input_iterator_tag;
+    using difference_type = std::ptrdiff_t;
+    using value_type = T;
+    using reference = const T&;
+    using pointer = const T*;
+
+    Iterator() = default;
+    explicit Iterator(Handle handle) : handle_(handle) {}
+
+    reference operator*() const {
+      return *handle_.promise().value_;
+    }
+    pointer operator->() const {
+      return handle_.promise().value_;
+    }
+    Iterator& operator++() {
+      Resume(handle_);
+      return *this;
+    }
+    void operator++(int) {
+      ++*this;
+    }
+    bool operator==(std::default_sentinel_t) const {
+      return !handle_ || handle_.done();
+    }
+  };
+
+  Generator(Generator&& other) noexcept
+      : handle_(std::exchange(other.handle_, nullptr)) {}
+  Generator& operator=(Generator&& other) noexcept {
+    if (this != &other) {
+      if (handle_) {
+        handle_.destroy();
+      }
+      handle_ = std::exchange(other.handle_, nullptr);
+    }
+    return *this;
+  }
+  Generator(const Generator&) = delete;
+  Generator& operator=(const Generator&) = delete;
+
+  ~Generator() {
+    if (handle_) {
+      handle_.destroy();
+    }
+  }
+
+  Iterator begin() {
+    Resume(handle_);
+    return Iterator{handle_};
+  }
+  std::default_sentinel_t end() const {
+    return {};
+  }
+};
+
+}  // namespace ArgumentParser
@@ -0,0 +1,99 @@
+#include "SchemaFile.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdio>
+#include <iostream>
+#include <utility>
+
+namespace ArgumentParser {
+
+MappedSchemaFile::MappedSchemaFile(void* data, size_t size)
+    : data_(data), size_(size) {}
+
+std::optional<MappedSchemaFile> MappedSchemaFile::Open(
+    const std::string& path) {
+  int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    std::cerr << "Can't open schema image " << path << std::endl;
+    return std::nullopt;
+  }
+  struct stat file_stat;
+  if (fstat(fd, &file_stat) != 0 || file_stat.st_size == 0) {
+    close(fd);
+    std::cerr << "Can't read schema image " << path << std::endl;
+    return std::nullopt;
+  }
+  size_t size = static_cast<size_t>(file_stat.st_size);
+  void* data = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (data == MAP_FAILED) {
+    std::cerr << "Can't map schema image " << path << std::endl;
+    return std::nullopt;
+  }
+  return MappedSchemaFile(data, size);
+}
+
+std::span<const char> MappedSchemaFile::Bytes() const {
+  return {static_cast<const char*>(data_), size_};
+}
+
+MappedSchemaFile::MappedSchemaFile(MappedSchemaFile&& other) noexcept
+    : data_(std::exchange(other.data_, nullptr)),
+      size_(std::exchange(other.size_, 0)) {}
+
+MappedSchemaFile& MappedSchemaFile::operator=(
+    MappedSchemaFile&& other) noexcept {
+  if (this != &other) {
+    if (data_) {
+      munmap(data_, size_);
+    }
+    data_ = std::exchange(other.data_, nullptr);
+    size_ = std::exchange(other.size_, 0);
+  }
+  return *this;
+}
+
+MappedSchemaFile::~MappedSchemaFile() {
+  if (data_) {
+    munmap(data_, size_);
+  }
+}
+
+// Processes may have the old image mapped, so the new one goes to a
+// separate file that replaces the name: existing mappings keep the old pages
+bool WriteSchemaImage(const std::string& path, std::span<const char> image) {
+  std::string temp_path = path + ".tmp." + std::to_string(getpid());
+  int fd = open(temp_path.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC,
+                0644);
+  if (fd < 0) {
+    std::cerr << "Can't create schema image " << temp_path << std::endl;
+    return false;
+  }
+  size_t written = 0;
+  while (written < image.size()) {
+    ssize_t result =
+        write(fd, image.data() + written, image.size() - written);
+    if (result < 0 && errno == EINTR) {
+      continue;
+    }
+    if (result <= 0) {
+      break;
+    }
+    written += result;
+  }
+  bool is_written = written == image.size() && fsync(fd) == 0;
+  is_written &= close(fd) == 0;
+  if (!is_written || rename(temp_path.c_str(), path.c_str()) != 0) {
+    unlink(temp_path.c_str());
+    std::cerr << "Can't write schema image " << path << std::endl;
+    return false;
+  }
+  return true;
+}
+
+}  // namespace ArgumentParser
@@ -0,0 +1,31 @@
+#pragma once
+#include <cstddef>
+#include <optional>
+#include <span>
+#include <string>
+
+#include "SchemaImage.h"
+
+namespace ArgumentParser {
+
+// Read-only file mapping shared between the processes that open the file
+class MappedSchemaFile {
+  void* data_ = nullptr;
+  size_t size_ = 0;
+
+  MappedSchemaFile(void* data, size_t size);
+
+ public:
+  static std::optional<MappedSchemaFile> Open(const std::string& path);
+  std::span<const char> Bytes() const;
+
+  MappedSchemaFile(MappedSchemaFile&& other) noexcept;
+  MappedSchemaFile& operator=(MappedSchemaFile&& other) noexcept;
+  MappedSchemaFile(const MappedSchemaFile&) = delete;
+  MappedSchemaFile& operator=(const MappedSchemaFile&) = delete;
+  ~MappedSchemaFile();
+};
+
+bool WriteSchemaImage(const std::string& path, std::span<const char> image);
+
+}  // namespace ArgumentParser
@@ -0,0 +1,204 @@
+#include "SchemaImage.h"
+
+#include <cstring>
+#include <iostream>
+
+namespace ArgumentParser {
+
+namespace {
+
+bool IsInside(const SchemaStringRef& ref, size_t begin, size_t end) {
+  return ref.offset >= begin && ref.offset <= end &&
+         ref.size <= end - ref.offset;
+}
+
+template <typename T>
+BaseArgument* MakeArgument(const SchemaImage& image,
+                           const SchemaArgumentRecord& record) {
+  std::string description(image.String(record.description));
+  ExactArgument<T>* arg = new ExactArgument<T>(
+      record.short_name, std::string(image.String(record.name)), description);
+  if (record.flags & kSchemaMultivalue) {
+    arg->MultiValue(record.minimum_args);
+  }
+  if (record.flags & kSchemaPositional) {
+    arg->Positional();
+  }
+  if (record.flags & kSchemaHasDefault) {
+    std::optional<T> default_value =
+        ArgumentTraits<T>::Parse(image.String(record.default_value));
+    if (default_value) {
+      arg->Default(*default_value);
+    }
+  }
+  return arg;
+}
+
+using ArgumentFactory = BaseArgument* (*)(const SchemaImage&,
+                                          const SchemaArgumentRecord&);
+
+struct ImageType {
+  std::string_view name;
+  ArgumentFactory factory;
+};
+
+const ImageType kImageTypes[] = {
+    {ArgumentTraits<std::string>::kTypeName, MakeArgument<std::string>},
+    {ArgumentTraits<bool>::kTypeName, MakeArgument<bool>},
+    {ArgumentTraits<int>::kTypeName, MakeArgument<int>},
+    {ArgumentTraits<int64_t>::kTypeName, MakeArgument<int64_t>},
+    {ArgumentTraits<uint64_t>::kTypeName, MakeArgument<uint64_t>},
+    {ArgumentTraits<double>::kTypeName, MakeArgument<double>},
+    {ArgumentTraits<float>::kTypeName, MakeArgument<float>},
+    {ArgumentTraits<ByteSize>::kTypeName, MakeArgument<ByteSize>},
+    {ArgumentTraits<Duration>::kTypeName, MakeArgument<Duration>},
+};
+
+}  // namespace
+
+uint32_t HashArgumentName(std::string_view name) {
+  uint32_t hash = 2166136261u;
+  for (char c : name) {
+    hash ^= static_cast<unsigned char>(c);
+    hash *= 16777619u;
+  }
+  return hash;
+}
+
+bool IsSchemaImageType(std::string_view type_name) {
+  for (const ImageType& type : kImageTypes) {
+    if (type.name == type_name) {
+      return true;
+    }
+  }
+  return false;
+}
+
+SchemaImage::SchemaImage(const char* data)
+    : data_(data),
+      header_(reinterpret_cast<const SchemaImageHeader*>(data)) {}
+
+std::optional<SchemaImage> SchemaImage::FromBytes(
+    std::span<const char> bytes) {
+  if (bytes.size() < sizeof(SchemaImageHeader) ||
+      reinterpret_cast<uintptr_t>(bytes.data()) %
+              alignof(SchemaImageHeader) !=
+          0) {
+    return std::nullopt;
+  }
+  const SchemaImageHeader* header =
+      reinterpret_cast<const SchemaImageHeader*>(bytes.data());
+  SchemaImageHeader expected;
+  if (std::memcmp(header->magic, expected.magic, sizeof(expected.magic)) !=
+          0 ||
+      header->version != expected.version ||
+      header->total_size != bytes.size()) {
+    return std::nullopt;
+  }
+
+  size_t size = bytes.size();
+  size_t count = header->arguments_count;
+  size_t table_size = header->hash_table_size;
+  if (header->arguments_offset % alignof(SchemaArgumentRecord) != 0 ||
+      header->arguments_offset > size ||
+      count > (size - header->arguments_offset) /
+                  sizeof(SchemaArgumentRecord) ||
+      header->hash_table_offset % alignof(uint32_t) != 0 ||
+      header->hash_table_offset > size ||
+      table_size > (size - header->hash_table_offset) / sizeof(uint32_t) ||
+      table_size == 0 || (table_size & (table_size - 1)) != 0 ||
+      header->strings_offset > size) {
+    return std::nullopt;
+  }
+
+  SchemaImage image(bytes.data());
+  size_t strings_begin = header->strings_offset;
+  if (!IsInside(header->name, strings_begin, size) ||
+      !IsInside(header->help_keyword, strings_begin, size)) {
+    return std::nullopt;
+  }
+  for (size_t i = 0; i < count; ++i) {
+    const SchemaArgumentRecord& record = image.Argument(i);
+    if (!IsInside(record.name, strings_begin, size) ||
+        !IsInside(record.description, strings_begin, size) ||
+        !IsInside(record.type_name, strings_begin, size) ||
+        !IsInside(record.default_value, strings_begin, size) ||
+        !IsSchemaImageType(image.String(record.type_name))) {
+      return std::nullopt;
+    }
+  }
+  const uint32_t* table =
+      reinterpret_cast<const uint32_t*>(bytes.data() + header->hash_table_offset);
+  bool has_empty_slot = false;
+  for (size_t i = 0; i < table_size; ++i) {
+    if (table[i] > count) {
+      return std::nullopt;
+    }
+    has_empty_slot |= table[i] == 0;
+  }
+  if (!has_empty_slot) {
+    return std::nullopt;
+  }
+  for (uint32_t slot : header->short_slots) {
+    if (slot > count) {
+      return std::nullopt;
+    }
+  }
+  return image;
+}
+
+std::string_view SchemaImage::Name() const {
+  return String(header_->name);
+}
+
+std::string_view SchemaImage::HelpKeyword() const {
+  return String(header_->help_keyword);
+}
+
+size_t SchemaImage::ArgumentsCount() const {
+  return header_->arguments_count;
+}
+
+const SchemaArgumentRecord& SchemaImage::Argument(size_t argument) const {
+  return reinterpret_cast<const SchemaArgumentRecord*>(
+      data_ + header_->arguments_offset)[argument];
+}
+
+std::string_view SchemaImage::String(const SchemaStringRef& ref) const {
+  return std::string_view(data_ + ref.offset, ref.size);
+}
+
+std::optional<size_t> SchemaImage::Find(std::string_view name) const {
+  const uint32_t* table =
+      reinterpret_cast<const uint32_t*>(data_ + header_->hash_table_offset);
+  uint32_t mask = header_->hash_table_size - 1;
+  // the table is at most half full, so probing ends at an empty slot
+  for (uint32_t i = HashArgumentName(name) & mask; table[i] != 0;
+       i = (i + 1) & mask) {
+    if (String(Argument(table[i] - 1).name) == name) {
+      return table[i] - 1;
+    }
+  }
+  return std::nullopt;
+}
+
+std::optional<size_t> SchemaImage::FindShort(char short_name) const {
+  uint32_t slot = header_->short_slots[static_cast<unsigned char>(short_name)];
+  if (slot == 0) {
+    return std::nullopt;
+  }
+  return slot - 1;
+}
+
+BaseArgument* SchemaImage::CreateArgument(size_t argument) const {
+  const SchemaArgumentRecord& record = Argument(argument);
+  std::string_view type_name = String(record.type_name);
+  for (const ImageType& type : kImageTypes) {
+    if (type.name == type_name) {
+      return type.factory(*this, record);
+    }
+  }
+  return nullptr;
+}
+
+}  // namespace ArgumentParser
@@ -0,0 +1,81 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+
+#include "ArgumentTypes.h"
+
+namespace ArgumentParser {
+
+// Binary layout of a compiled schema. Everything is addressed by offsets
+// from the image start, so the image works at any mapping address
+struct SchemaStringRef {
+  uint32_t offset = 0;
+  uint32_t size = 0;
+};
+
+struct SchemaArgumentRecord {
+  SchemaStringRef name;
+  SchemaStringRef description;
+  SchemaStringRef type_name;
+  SchemaStringRef default_value;
+  uint64_t minimum_args = 1;
+  char short_name = '\0';
+  uint8_t flags = 0;
+  uint8_t reserved[6] = {};
+};
+
+enum SchemaArgumentFlags : uint8_t {
+  kSchemaPositional = 1,
+  kSchemaMultivalue = 2,
+  kSchemaHasDefault = 4,
+  kSchemaBitwise = 8,
+};
+
+struct SchemaImageHeader {
+  char magic[4] = {'A', 'P', 'S', 'I'};
+  uint32_t version = 1;
+  uint32_t total_size = 0;
+  uint32_t arguments_count = 0;
+  uint32_t arguments_offset = 0;
+  uint32_t hash_table_size = 0;  // power of two
+  uint32_t hash_table_offset = 0;
+  uint32_t strings_offset = 0;
+  SchemaStringRef name;
+  SchemaStringRef help_keyword;
+  uint32_t short_slots[256] = {};  // argument index + 1, 0 for unused
+};
+
+uint32_t HashArgumentName(std::string_view name);
+
+// Read-only view of an image built by ArgParser::CompileSchema, e.g. mapped
+// from a file or a shared memory segment. The bytes must outlive the view
+class SchemaImage {
+  const char* data_ = nullptr;
+  const SchemaImageHeader* header_ = nullptr;
+
+  explicit SchemaImage(const char* data);
+
+ public:
+  // Checks the layout once so lookups don't need bounds checks
+  static std::optional<SchemaImage> FromBytes(std::span<const char> bytes);
+
+  std::string_view Name() const;
+  std::string_view HelpKeyword() const;
+  size_t ArgumentsCount() const;
+  const SchemaArgumentRecord& Argument(size_t argument) const;
+  std::string_view String(const SchemaStringRef& ref) const;
+
+  std::optional<size_t> Find(std::string_view name) const;
+  std::optional<size_t> FindShort(char short_name) const;
+
+  // Heap argument built from the record, with its default applied
+  BaseArgument* CreateArgument(size_t argument) const;
+};
+
+bool IsSchemaImageType(std::string_view type_name);
+
+}  // namespace ArgumentParser
@@ -1,6 +1,12 @@
 #include <lib/ArgParser.h>
+#include <lib/ConfigWatcher.h>
+#include <lib/SchemaFile.h>
 #include <gtest/gtest.h>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
 #include <sstream>
+#include <thread>
 
 
 using namespace ArgumentParser;
@@ -180,3 +186,453 @@ TEST(ArgParserTestSuite, HelpStringTest) {
     //     "-h, --help Display this help and exit\n"
     // );
 }
+
+
+TEST(ArgParserTestSuite, ReparseTest) {
+    ArgParser parser("My Parser");
+    std::vector<int> values;
+    parser.AddStringArgument('i', "input");
+    parser.AddIntArgument("number").Default(1);
+    parser.AddFlag('v', "verbose");
+    parser.AddIntArgument("N").MultiValue().Positional().StoreValues(values);
+
+    ASSERT_TRUE(parser.Parse(SplitString("app -i=a.txt --number=5 1 2 3")));
+
+    std::optional<std::vector<std::string>> changed =
+        parser.Reparse(SplitString("app --input=a.txt -v --number=5 1 2 3"));
+    ASSERT_TRUE(changed);
+    ASSERT_EQ(*changed, std::vector<std::string>{"verbose"});
+    ASSERT_TRUE(parser.GetFlag("verbose"));
+    ASSERT_EQ(values.size(), 3);
+
+    changed = parser.Reparse(SplitString("app --input=b.txt -v 1 2"));
+    ASSERT_TRUE(changed);
+    ASSERT_EQ(*changed, (std::vector<std::string>{"input", "number", "N"}));
+    ASSERT_EQ(parser.GetStringValue("input"), "b.txt");
+    ASSERT_EQ(parser.GetIntValue("number"), 1);
+    ASSERT_EQ(values, (std::vector<int>{1, 2}));
+
+    changed = parser.Reparse(SplitString("app --input=b.txt -v 1 2"));
+    ASSERT_TRUE(changed);
+    ASSERT_TRUE(changed->empty());
+}
+
+
+TEST(ArgParserTestSuite, ReparseChangedTokensTest) {
+    ArgParser parser("My Parser");
+    int threads = 0;
+    bool verbose = false;
+    parser.AddIntArgument("threads").StoreValue(threads);
+    parser.AddStringArgument('m', "mode").Default("fast");
+    parser.AddFlag('v', "verbose").StoreValue(verbose);
+    parser.AddIntArgument("N").MultiValue().Positional();
+
+    ASSERT_TRUE(parser.Reparse(SplitString("app --threads=4 -v 1 2 3")));
+    ASSERT_EQ(threads, 4);
+
+    // only the changed option is parsed again
+    std::optional<std::vector<std::string>> changed =
+        parser.Reparse(SplitString("app --threads=8 -v 1 2 3"));
+    ASSERT_TRUE(changed);
+    ASSERT_EQ(*changed, std::vector<std::string>{"threads"});
+    ASSERT_EQ(parser.Statistics().tokens, 1);
+    ASSERT_EQ(threads, 8);
+
+    // a bare value right after the change needs the full walk
+    changed = parser.Reparse(SplitString("app --threads=8 -m=safe 1 2 3"));
+    ASSERT_TRUE(changed);
+    ASSERT_EQ(*changed, (std::vector<std::string>{"mode", "verbose"}));
+    ASSERT_EQ(parser.Statistics().tokens, 5);
+    ASSERT_FALSE(verbose);
+
+    // a rejected command line keeps the live values
+    ASSERT_FALSE(parser.Reparse(SplitString("app --threads=abc -m=safe 1 2 3")));
+    ASSERT_FALSE(parser.Reparse(SplitString("app --threads=2 -v")));
+    ASSERT_EQ(threads, 8);
+    ASSERT_EQ(parser.GetStringValue("mode"), "safe");
+    ASSERT_EQ(parser.GetIntValues("N").size(), 3);
+
+    changed = parser.Reparse(SplitString("app --threads=8 -v 1 2"));
+    ASSERT_TRUE(changed);
+    ASSERT_EQ(*changed, (std::vector<std::string>{"mode", "verbose", "N"}));
+    ASSERT_EQ(parser.Statistics().tokens, 4);
+    ASSERT_EQ(parser.GetStringValue("mode"), "fast");
+    ASSERT_TRUE(verbose);
+}
+
+TEST(ArgParserTestSuite, ReparseGreedyValuesTest) {
+    ArgParser parser("My Parser");
+    parser.AddFlag('a', "all");
+    parser.AddIntArgument('m', "multi").MultiValue(0);
+    parser.AddIntArgument("N").MultiValue(0).Positional();
+
+    ASSERT_TRUE(parser.Reparse(SplitString("app -m=4 --all 9")));
+    ASSERT_EQ(parser.GetIntValues("multi").size(), 1);
+    ASSERT_EQ(parser.GetIntValue("N", 0), 9);
+
+    /* Без --all значение 9 достаётся multi, как и при полном разборе */
+    std::optional<std::vector<std::string>> changed =
+        parser.Reparse(SplitString("app -m=4 9"));
+    ASSERT_TRUE(changed);
+    ASSERT_EQ(*changed, (std::vector<std::string>{"all", "multi", "N"}));
+    ASSERT_EQ(parser.GetIntValues("multi").size(), 2);
+    ASSERT_EQ(parser.GetIntValue("multi", 1), 9);
+    ASSERT_TRUE(parser.GetIntValues("N").empty());
+
+    ArgParser fresh("My Parser");
+    fresh.AddFlag('a', "all");
+    fresh.AddIntArgument('m', "multi").MultiValue(0);
+    fresh.AddIntArgument("N").MultiValue(0).Positional();
+    ASSERT_TRUE(fresh.Parse(SplitString("app -m=4 9")));
+    ASSERT_EQ(fresh.GetIntValues("multi").size(), 2);
+    ASSERT_EQ(fresh.GetIntValue("multi", 1), 9);
+    ASSERT_TRUE(fresh.GetIntValues("N").empty());
+
+    /* Новая опция перед значением тоже ведёт к полному разбору */
+    changed = parser.Reparse(SplitString("app --all -m=4 9"));
+    ASSERT_TRUE(changed);
+    ASSERT_EQ(*changed, std::vector<std::string>{"all"});
+    ASSERT_EQ(parser.GetIntValues("multi").size(), 2);
+}
+
+
+struct WatchedConfig {
+    int threads = 0;
+    std::string mode;
+};
+
+TEST(ArgParserTestSuite, ConfigWatcherTest) {
+    std::string path = testing::TempDir() + "argparser_watched.conf";
+    std::ofstream(path) << "--threads=4 --mode=fast\n";
+
+    ConfigWatcher<WatchedConfig> watcher(
+        "app", path, [](ArgParser& parser, WatchedConfig& config) {
+            parser.AddIntArgument("threads").StoreValue(config.threads);
+            parser.AddStringArgument("mode").StoreValue(config.mode);
+        });
+    ASSERT_TRUE(watcher.IsWatching());
+    ASSERT_EQ(watcher.Version(), 1);
+    ConfigWatcher<WatchedConfig>::Snapshot old_config = watcher.Get();
+    ASSERT_EQ(old_config->threads, 4);
+
+    std::ofstream(path + ".tmp") << "--threads=8 --mode=safe\n";
+    std::rename((path + ".tmp").c_str(), path.c_str());
+    for (int i = 0; i < 500 && watcher.Version() < 2; ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    ASSERT_EQ(watcher.Version(), 2);
+    ASSERT_EQ(watcher.Get()->threads, 8);
+    ASSERT_EQ(watcher.Get()->mode, "safe");
+    ASSERT_EQ(old_config->mode, "fast");
+
+    std::remove(path.c_str());
+}
+
+
+TEST(ArgParserTestSuite, ParseEventsTest) {
+    ArgParser parser("My Parser");
+    parser.AddStringArgument('i', "input");
+    parser.AddFlag('v', "verbose");
+    parser.AddIntArgument("N").MultiValue().Positional();
+
+    std::vector<std::string> args = SplitString("app -v --input=a.txt 1 2");
+    std::vector<std::string> names;
+    std::vector<std::string> values;
+    std::vector<size_t> indices;
+    for (const ParseEvent& event : parser.ParseEvents(args)) {
+        ASSERT_EQ(event.status, ErrorStatus::kNoErrors);
+        names.emplace_back(event.name);
+        values.emplace_back(event.value);
+        indices.push_back(event.token_index);
+    }
+    ASSERT_EQ(names, (std::vector<std::string>{"verbose", "input", "N", "N"}));
+    ASSERT_EQ(values, (std::vector<std::string>{"true", "a.txt", "1", "2"}));
+    ASSERT_EQ(indices, (std::vector<size_t>{1, 2, 3, 4}));
+    ASSERT_EQ(parser.GetIntValue("N", 1), 2);
+}
+
+
+TEST(ArgParserTestSuite, PositionalOrderTest) {
+    /* Позиционные значения и значения по имени идут в порядке командной строки */
+    ArgParser parser("My Parser");
+    parser.AddIntArgument("N").MultiValue().Positional();
+
+    ASSERT_TRUE(parser.Parse(SplitString("app 9 --N=2")));
+    ASSERT_EQ(parser.GetIntValues("N").size(), 2);
+    ASSERT_EQ(parser.GetIntValue("N", 0), 9);
+    ASSERT_EQ(parser.GetIntValue("N", 1), 2);
+}
+
+
+TEST(ArgParserTestSuite, ParseEventsEarlyStopTest) {
+    ArgParser parser("My Parser");
+    parser.AddHelp('h', "help", "Some Description about program");
+    parser.AddIntArgument("N").MultiValue().Positional();
+
+    std::vector<std::string> args = SplitString("app --help --unknown 1 2 3");
+    size_t events_count = 0;
+    for (const ParseEvent& event : parser.ParseEvents(args)) {
+        ++events_count;
+        if (event.name == "help") {
+            break;
+        }
+    }
+    ASSERT_EQ(events_count, 1);
+    ASSERT_TRUE(parser.Help());
+    ASSERT_THROW(parser.GetIntValue("N"), std::out_of_range);
+}
+
+
+TEST(ArgParserTestSuite, LimitsTest) {
+    ArgParser parser("My Parser");
+    std::vector<int> values;
+    parser.AddStringArgument('s', "str");
+    parser.AddIntArgument("N").MultiValue().Positional().StoreValues(values);
+    parser.SetLimits({.max_tokens = 6, .max_values = 3, .max_value_length = 8});
+
+    ASSERT_TRUE(parser.Parse(SplitString("app -s=short 1 2 3")));
+    ASSERT_FALSE(parser.Parse(SplitString("app 1 2 3 4 5 6")));
+    ASSERT_FALSE(parser.Parse(SplitString("app -s=very_long_value")));
+
+    ArgParser multivalue_parser("My Parser");
+    std::vector<int> multi_values;
+    multivalue_parser.AddIntArgument("N").MultiValue().Positional().StoreValues(multi_values);
+    multivalue_parser.SetLimits({.max_values = 3});
+    ASSERT_FALSE(multivalue_parser.Parse(SplitString("app 1 2 3 4")));
+    ASSERT_EQ(multi_values.size(), 3);
+
+    std::vector<std::string> args = SplitString("app --str=abcdef");
+    std::vector<char*> argv;
+    for (std::string& arg : args) {
+        argv.push_back(arg.data());
+    }
+    parser.SetLimits({.max_total_bytes = 10});
+    ASSERT_FALSE(parser.Parse(argv.size(), argv.data()));
+    parser.SetLimits({.max_total_bytes = 20});
+    ASSERT_TRUE(parser.Parse(argv.size(), argv.data()));
+}
+
+
+TEST(ArgParserTestSuite, BulkValuesTest) {
+    ArgParser parser("My Parser");
+    parser.AddIntArgument("N").MultiValue().Positional();
+    parser.AddStringArgument('i', "input").MultiValue();
+    parser.AddIntArgument("number").Default(7);
+
+    ASSERT_TRUE(parser.Parse(SplitString("app 1 2 3 -i=a.txt -i=b.txt")));
+    std::span<const int> values = parser.GetIntValues("N");
+    ASSERT_EQ(std::vector<int>(values.begin(), values.end()), (std::vector<int>{1, 2, 3}));
+    ASSERT_EQ(parser.GetValuesCount("N"), 3);
+    ASSERT_EQ(parser.GetStringValues("input")[1], "b.txt");
+    ASSERT_EQ(parser.GetValuesCount("input"), 2);
+    ASSERT_EQ(parser.GetIntValues("number").size(), 1);
+    ASSERT_EQ(parser.GetIntValues("number")[0], 7);
+    ASSERT_THROW(parser.GetIntValues("input"), std::runtime_error);
+
+    ArgParser unset_parser("My Parser");
+    unset_parser.AddIntArgument("opt");
+    ASSERT_FALSE(unset_parser.Parse(SplitString("app")));
+    ASSERT_EQ(unset_parser.GetValuesCount("opt"), 0);
+    ASSERT_TRUE(unset_parser.GetIntValues("opt").empty());
+}
+
+
+TEST(ArgParserTestSuite, ParseManyTest) {
+    ArgParser parser("My Parser");
+    std::vector<int> stored;
+    parser.AddIntArgument("N").MultiValue().Positional().StoreValues(stored);
+    parser.AddFlag('s', "sum");
+
+    std::vector<std::vector<std::string>> command_lines;
+    for (int i = 0; i < 1000; ++i) {
+        std::string line = "app -s " + std::to_string(i) + " " + std::to_string(i + 1);
+        command_lines.push_back(SplitString(i % 3 == 0 ? line + " x" : line));
+    }
+    std::vector<int> sums(command_lines.size());
+    std::vector<bool> results = parser.ParseMany(
+        command_lines, [&sums](size_t i, const ArgParser& parsed) {
+            for (int value : parsed.GetIntValues("N")) {
+                sums[i] += value;
+            }
+        }, 4);
+
+    ASSERT_EQ(results.size(), command_lines.size());
+    for (int i = 0; i < 1000; ++i) {
+        ASSERT_EQ(results[i], i % 3 != 0);
+        ASSERT_EQ(sums[i], 2 * i + 1);
+    }
+    ASSERT_TRUE(stored.empty());
+
+    ASSERT_THROW(parser.ParseMany(
+        command_lines, [](size_t i, const ArgParser&) {
+            if (i % 250 == 0) {
+                throw std::runtime_error("callback failed");
+            }
+        }, 4), std::runtime_error);
+}
+
+
+TEST(ArgParserTestSuite, NumericTypesTest) {
+    ArgParser parser("My Parser");
+    parser.AddArgument<int64_t>("offset");
+    parser.AddArgument<uint64_t>("count");
+    parser.AddArgument<double>("ratio");
+    parser.AddArgument<float>("scale").Default(0.5f);
+    parser.AddArgument<ByteSize>('m', "memory").Default(ByteSize{4ull << 30});
+    parser.AddArgument<Duration>('t', "timeout").MultiValue();
+
+    ASSERT_TRUE(parser.Parse(SplitString(
+        "app --offset=-9000000000 --count=18000000000000000000 --ratio=2.5 "
+        "-m=512KB -t=250ms -t=2h")));
+    ASSERT_EQ(parser.GetValue<int64_t>("offset"), -9000000000);
+    ASSERT_EQ(parser.GetValue<uint64_t>("count"), 18000000000000000000ull);
+    ASSERT_DOUBLE_EQ(parser.GetValue<double>("ratio"), 2.5);
+    ASSERT_FLOAT_EQ(parser.GetValue<float>("scale"), 0.5f);
+    ASSERT_EQ(parser.GetValue<ByteSize>("memory").bytes, 512000);
+    ASSERT_EQ(parser.GetValue<Duration>("timeout", 0), std::chrono::milliseconds(250));
+    ASSERT_EQ(parser.GetValues<Duration>("timeout")[1], std::chrono::hours(2));
+
+    ASSERT_NE(parser.HelpDescription().find("--memory=<size>"), std::string::npos);
+    ASSERT_NE(parser.HelpDescription().find("[default = 4GiB]"), std::string::npos);
+
+    ASSERT_FALSE(ArgumentTraits<ByteSize>::Parse("20000000TiB"));
+    ASSERT_FALSE(ArgumentTraits<Duration>::Parse("10"));
+    ASSERT_FALSE(ArgumentTraits<Duration>::Parse("10days"));
+    char buffer[kFormatBufferSize];
+    ASSERT_EQ(ArgumentTraits<Duration>::Format(std::chrono::seconds(90), buffer), "90s");
+    ASSERT_EQ(ArgumentTraits<ByteSize>::Format(ByteSize{1000000000000}, buffer), "1TB");
+}
+
+
+TEST(ArgParserTestSuite, SchemaImageTest) {
+    ArgParser schema("My Parser");
+    schema.AddStringArgument('i', "input", "Input file");
+    schema.AddIntArgument('p', "param").MultiValue(1).Default(7);
+    schema.AddArgument<ByteSize>("memory").Default(ByteSize{1 << 20});
+    schema.AddFlag('v', "verbose");
+    schema.AddIntArgument("N").MultiValue(1).Positional();
+    schema.AddHelp('h', "help", "Program accumulate arguments");
+
+    std::optional<std::vector<char>> compiled = schema.CompileSchema();
+    ASSERT_TRUE(compiled);
+    std::string path = testing::TempDir() + "argparser_schema.img";
+    ASSERT_TRUE(WriteSchemaImage(path, *compiled));
+
+    std::optional<MappedSchemaFile> file = MappedSchemaFile::Open(path);
+    ASSERT_TRUE(file);
+    std::optional<SchemaImage> image = SchemaImage::FromBytes(file->Bytes());
+    ASSERT_TRUE(image);
+    ASSERT_EQ(image->ArgumentsCount(), 6);
+
+    ArgParser parser(*image);
+    ASSERT_TRUE(parser.Parse(SplitString("app -i=file -v 1 2 3")));
+    ASSERT_EQ(parser.GetStringValue("input"), "file");
+    ASSERT_TRUE(parser.GetFlag("verbose"));
+    ASSERT_EQ(parser.GetIntValue("param"), 7);
+    ASSERT_EQ(parser.GetValue<ByteSize>("memory").bytes, 1 << 20);
+    ASSERT_EQ(parser.GetIntValue("N", 2), 3);
+    ASSERT_FALSE(parser.Help());
+    ASSERT_EQ(parser.HelpDescription(), schema.HelpDescription());
+
+    ArgParser missing(*image);
+    ASSERT_FALSE(missing.Parse(SplitString("app 1 2")));
+
+    // rewriting the file leaves the mapped image intact
+    ArgParser other_schema("Other Parser");
+    other_schema.AddFlag('x', "extra");
+    ASSERT_TRUE(WriteSchemaImage(path, *other_schema.CompileSchema()));
+    ASSERT_TRUE(std::equal(compiled->begin(), compiled->end(), file->Bytes().begin()));
+    ASSERT_EQ(parser.GetStringValue("input"), "file");
+    std::optional<MappedSchemaFile> new_file = MappedSchemaFile::Open(path);
+    ASSERT_TRUE(new_file);
+    ASSERT_EQ(SchemaImage::FromBytes(new_file->Bytes())->Name(), "Other Parser");
+
+    std::vector<char> corrupt = *compiled;
+    corrupt[0] = 'X';
+    ASSERT_FALSE(SchemaImage::FromBytes(corrupt));
+    corrupt = *compiled;
+    corrupt.pop_back();
+    ASSERT_FALSE(SchemaImage::FromBytes(corrupt));
+}
+
+
+TEST(ArgParserTestSuite, ShortClusterTest) {
+    ArgParser parser("My Parser");
+    bool verbose = false;
+    parser.AddFlag('a', "all");
+    parser.AddFlag('b', "brief");
+    auto& verbose_flag = parser.AddFlag('v', "verbose").StoreValue(verbose);
+    parser.AddIntArgument('p', "param");
+
+    ASSERT_TRUE(parser.Parse(SplitString("app -avb -p=5")));
+    ASSERT_TRUE(parser.GetFlag("all"));
+    ASSERT_TRUE(parser.GetFlag("brief"));
+    ASSERT_TRUE(verbose);
+    ASSERT_EQ(parser.GetIntValue("param"), 5);
+
+    /* Хранилище, привязанное после разбора, тоже должно заполняться */
+    bool other_verbose = false;
+    verbose_flag.StoreValue(other_verbose);
+    ASSERT_TRUE(parser.Parse(SplitString("app -av")));
+    ASSERT_TRUE(other_verbose);
+
+    std::vector<std::string> args = SplitString("app -axb");
+    std::vector<ParseEvent> events;
+    for (const ParseEvent& event : parser.ParseEvents(args)) {
+        events.push_back(event);
+    }
+    ASSERT_EQ(events.size(), 2);
+    ASSERT_EQ(events[0].name, "all");
+    ASSERT_EQ(events[1].status, ErrorStatus::kUnknownArgument);
+    ASSERT_EQ(events[1].name, "x");
+    ASSERT_TRUE(events[1].is_fatal);
+    ASSERT_FALSE(parser.Parse(args));
+
+    std::optional<std::vector<char>> compiled = parser.CompileSchema();
+    ASSERT_TRUE(compiled);
+    std::optional<SchemaImage> image = SchemaImage::FromBytes(*compiled);
+    ASSERT_TRUE(image);
+    ArgParser image_parser(*image);
+    ASSERT_TRUE(image_parser.Parse(SplitString("app -vb -p=3")));
+    ASSERT_TRUE(image_parser.GetFlag("verbose"));
+    ASSERT_FALSE(image_parser.GetFlag("all"));
+    ASSERT_EQ(image_parser.GetIntValue("param"), 3);
+}
+
+
+TEST(ArgParserTestSuite, ShortValueTest) {
+    /* Значение через пробел после короткой опции: в конце argv и перед другой опцией */
+    auto make_parser = [](ArgParser& parser) {
+        parser.AddStringArgument('s', "str");
+        parser.AddIntArgument('m', "multi").MultiValue(0);
+        parser.AddFlag('v', "verbose");
+        parser.AddIntArgument("N").MultiValue(0).Positional();
+    };
+
+    ArgParser at_end("My Parser");
+    make_parser(at_end);
+    ASSERT_TRUE(at_end.Parse(SplitString("app 1 -s 9")));
+    ASSERT_EQ(at_end.GetStringValue("str"), "9");
+    ASSERT_EQ(at_end.GetIntValues("N").size(), 1);
+
+    ArgParser before_option("My Parser");
+    make_parser(before_option);
+    ASSERT_TRUE(before_option.Parse(SplitString("app -s 9 -v 2 3")));
+    ASSERT_EQ(before_option.GetStringValue("str"), "9");
+    ASSERT_TRUE(before_option.GetFlag("verbose"));
+    ASSERT_EQ(before_option.GetIntValues("N").size(), 2);
+    ASSERT_EQ(before_option.GetIntValue("N", 0), 2);
+
+    ArgParser multi("My Parser");
+    make_parser(multi);
+    ASSERT_TRUE(multi.Parse(SplitString("app -m 4 5 -s x")));
+    ASSERT_EQ(multi.GetIntValues("multi").size(), 2);
+    ASSERT_EQ(multi.GetIntValue("multi", 0), 4);
+    ASSERT_EQ(multi.GetIntValue("multi", 1), 5);
+    ASSERT_EQ(multi.GetStringValue("str"), "x");
+    ASSERT_TRUE(multi.GetIntValues("N").empty());
+
+    ArgParser missing("My Parser");
+    make_parser(missing);
+    ASSERT_FALSE(missing.Parse(SplitString("app 1 -s")));
+}
@@ -0,0 +1,188 @@
+#include <lib/ArgParser.h>
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <cstdlib>
+#include <functional>
+#include <new>
+#include <string>
+#include <vector>
+
+
+using namespace ArgumentParser;
+
+/*
+    Глобальный operator new считает выделения памяти, чтобы тесты могли
+    проверить, что Parse выделяет память и ищет аргументы линейно от числа токенов
+*/
+static std::atomic<size_t> allocations_count{0};
+static std::atomic<size_t> allocated_bytes{0};
+
+void* operator new(size_t size) {
+    ++allocations_count;
+    allocated_bytes += size;
+    if (void* ptr = std::malloc(size == 0 ? 1 : size)) {
+        return ptr;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* ptr) noexcept {
+    std::free(ptr);
+}
+
+void operator delete(void* ptr, size_t) noexcept {
+    std::free(ptr);
+}
+
+
+struct ParseCost {
+    double allocations_per_token;
+    double lookups_per_token;
+    size_t visited_tokens;
+};
+
+using SchemaSetup = std::function<void(ArgParser&)>;
+using ArgsFactory = std::function<std::vector<std::string>(size_t)>;
+
+ParseCost MeasureParse(const SchemaSetup& setup, const ArgsFactory& make_args, size_t tokens_count) {
+    std::vector<std::string> args = make_args(tokens_count);
+    ArgParser parser("My Parser");
+    setup(parser);
+
+    size_t allocations_before = allocations_count;
+    EXPECT_TRUE(parser.Parse(args));
+    size_t allocations = allocations_count - allocations_before;
+
+    double tokens = static_cast<double>(args.size());
+    return {allocations / tokens, parser.Statistics().lookups / tokens, parser.Statistics().tokens};
+}
+
+/*
+    Стоимость в пересчете на токен для 10k и 100k токенов не должна заметно
+    превышать стоимость для 1k токенов, а сама стоимость - заданный бюджет
+*/
+void ExpectLinear(const SchemaSetup& setup, const ArgsFactory& make_args, double max_allocations_per_token) {
+    ParseCost base = MeasureParse(setup, make_args, 1000);
+    EXPECT_LE(base.allocations_per_token, max_allocations_per_token);
+    for (size_t tokens_count : {10000, 100000}) {
+        ParseCost cost = MeasureParse(setup, make_args, tokens_count);
+        EXPECT_LE(cost.allocations_per_token, base.allocations_per_token * 1.25 + 0.05)
+            << tokens_count << " tokens";
+        EXPECT_LE(cost.lookups_per_token, base.lookups_per_token * 1.05 + 0.01)
+            << tokens_count << " tokens";
+        EXPECT_EQ(cost.visited_tokens, tokens_count);
+    }
+}
+
+
+TEST(ArgParserComplexityTestSuite, PositionalTest) {
+    ExpectLinear(
+        [](ArgParser& parser) {
+            parser.AddIntArgument("N").MultiValue().Positional();
+            parser.AddFlag("sum");
+        },
+        [](size_t tokens_count) {
+            std::vector<std::string> args = {"app", "--sum"};
+            for (size_t i = 2; i <= tokens_count; ++i) {
+                args.push_back(std::to_string(i));
+            }
+            return args;
+        },
+        0.1);
+}
+
+
+TEST(ArgParserComplexityTestSuite, LongOptionTest) {
+    ExpectLinear(
+        [](ArgParser& parser) {
+            parser.AddStringArgument("input").MultiValue();
+            parser.AddIntArgument("param").MultiValue();
+        },
+        [](size_t tokens_count) {
+            std::vector<std::string> args = {"app"};
+            for (size_t i = 1; i <= tokens_count; ++i) {
+                args.push_back(i % 2 ? "--param=" + std::to_string(i) : "--input=file" + std::to_string(i % 100));
+            }
+            return args;
+        },
+        2);
+}
+
+
+TEST(ArgParserComplexityTestSuite, ShortOptionTest) {
+    ExpectLinear(
+        [](ArgParser& parser) {
+            parser.AddFlag('a', "flag1");
+            parser.AddFlag('b', "flag2");
+            parser.AddIntArgument('p', "param").MultiValue();
+        },
+        [](size_t tokens_count) {
+            std::vector<std::string> args = {"app"};
+            for (size_t i = 1; i <= tokens_count; ++i) {
+                args.push_back(i % 2 ? "-ab" : "-p=" + std::to_string(i));
+            }
+            return args;
+        },
+        2.5);
+}
+
+
+/*
+    Токены длиннее буфера короткой строки: любое копирование argv или значений
+    при разборе добавляет по выделению памяти на токен и выходит за бюджет
+*/
+TEST(ArgParserComplexityTestSuite, LongTokenTest) {
+    ExpectLinear(
+        [](ArgParser& parser) {
+            parser.AddStringArgument("path").MultiValue().Positional();
+            parser.AddStringArgument('o', "output").MultiValue();
+        },
+        [](size_t tokens_count) {
+            std::vector<std::string> args = {"app"};
+            for (size_t i = 1; i <= tokens_count; ++i) {
+                std::string path = "/home/user/projects/input/file_" + std::to_string(i % 100) + ".txt";
+                args.push_back(i % 2 ? path : "--output=" + path);
+            }
+            return args;
+        },
+        2.6);
+}
+
+
+TEST(ArgParserComplexityTestSuite, LimitsFailFastTest) {
+    std::vector<std::string> args(100000, std::string(100, '1'));
+    ArgParser parser("My Parser");
+    parser.AddIntArgument("N").MultiValue().Positional();
+    parser.SetLimits({.max_tokens = 3});
+
+    size_t allocations_before = allocations_count;
+    EXPECT_FALSE(parser.Parse(args));
+    EXPECT_FALSE(parser.Reparse(args));
+    EXPECT_EQ(allocations_count - allocations_before, 0);
+}
+
+
+/*
+    Вызывающий, который останавливается на --help, не должен платить за
+    остаток argv: ни проходом по токенам, ни памятью под их разметку
+*/
+TEST(ArgParserComplexityTestSuite, EarlyStopTest) {
+    auto measure = [](size_t tokens_count) {
+        std::vector<std::string> args = {"app", "--help"};
+        args.resize(tokens_count, "12345");
+        ArgParser parser("My Parser");
+        parser.AddHelp('h', "help", "Some Description about program");
+        parser.AddIntArgument("N").MultiValue().Positional();
+
+        size_t bytes_before = allocated_bytes;
+        for (const ParseEvent& event : parser.ParseEvents(args)) {
+            if (event.name == "help") {
+                break;
+            }
+        }
+        EXPECT_EQ(parser.Statistics().tokens, 1);
+        return allocated_bytes - bytes_before;
+    };
+    EXPECT_EQ(measure(100000), measure(1000));
+}
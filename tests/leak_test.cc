@@ -0,0 +1,54 @@
+#include <lib/ConfigWatcher.h>
+#include <gtest/gtest.h>
+#include <sanitizer/lsan_interface.h>
+
+#include <fstream>
+#include <string>
+#include <vector>
+
+using namespace ArgumentParser;
+
+struct ReloadedConfig {
+    int threads = 0;
+    std::string mode;
+    std::vector<int> ports;
+};
+
+TEST(LeakTestSuite, ConfigReloadTest) {
+    /*
+        Каждая перезагрузка создаёт новый парсер и привязывает поля через
+        StoreValue/StoreValues, после разрушения наблюдателя утечек быть не должно
+    */
+    std::string path = testing::TempDir() + "argparser_leak.conf";
+    std::ofstream(path) << "--threads=1 --mode=fast --ports 80\n";
+    {
+        ConfigWatcher<ReloadedConfig> watcher(
+            "app", path, [](ArgParser& parser, ReloadedConfig& config) {
+                parser.AddIntArgument("threads").StoreValue(config.threads);
+                parser.AddStringArgument("mode").StoreValue(config.mode);
+                parser.AddIntArgument("ports").StoreValues(config.ports).MultiValue();
+            });
+        for (int i = 0; i < 200; ++i) {
+            std::ofstream(path) << "--threads=" << i << " --mode=safe --ports 80 443\n";
+            ASSERT_TRUE(watcher.Reload());
+        }
+        ASSERT_EQ(watcher.Get()->threads, 199);
+        ASSERT_EQ(watcher.Get()->ports.size(), 2);
+    }
+    ASSERT_EQ(__lsan_do_recoverable_leak_check(), 0);
+
+    std::remove(path.c_str());
+}
+
+TEST(LeakTestSuite, StoreValueTest) {
+    {
+        ArgParser parser("My Parser");
+        int value = 0;
+        std::vector<int> values;
+        parser.AddIntArgument("first").StoreValue(value).StoreValue(value);
+        parser.AddIntArgument("second").StoreValues(values);
+        parser.AddIntArgument("third").MultiValue().StoreValues(values).StoreValues(values);
+        parser.AddIntArgument("fourth").StoreValue(value).MultiValue();
+    }
+    ASSERT_EQ(__lsan_do_recoverable_leak_check(), 0);
+}
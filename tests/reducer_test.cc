@@ -0,0 +1,135 @@
+#include <bin/Reducer.h>
+#include <gtest/gtest.h>
+
+#include <cstdio>
+#include <limits>
+#include <string>
+#include <vector>
+
+namespace {
+
+const int kIntMax = std::numeric_limits<int>::max();
+const int kIntMin = std::numeric_limits<int>::min();
+const size_t kReadBufferSize = 1 << 16;
+
+/* Записывает text во временный файл и сворачивает его через ReduceStream */
+bool ReduceText(const std::string& text, Reducer& reducer) {
+    std::FILE* file = std::tmpfile();
+    if(!file) {
+        return false;
+    }
+    std::fwrite(text.data(), 1, text.size(), file);
+    std::rewind(file);
+    bool result = ReduceStream(file, reducer);
+    std::fclose(file);
+    return result;
+}
+
+} // namespace
+
+TEST(ReducerTestSuite, SumTest) {
+    Reducer reducer(Reducer::Operation::kSum);
+    std::vector<int> values = {1, -2, 3, 4, 5, 6, 7};
+    reducer.Add(values);
+    reducer.Add({});
+    ASSERT_EQ(reducer.Result(), "24");
+    ASSERT_FALSE(reducer.IsOverflow());
+}
+
+TEST(ReducerTestSuite, SumPromotionTest) {
+    /*
+        Сумма 2^32 + 2^16 максимальных int не помещается в int64,
+        дальше счёт должен идти в int128
+    */
+    Reducer reducer(Reducer::Operation::kSum);
+    std::vector<int> values(1 << 16, kIntMax);
+    for(size_t i = 0; i < (size_t{1} << 16) + 1; ++i) {
+        reducer.Add(values);
+    }
+    ASSERT_EQ(reducer.Result(), "9223512770048098304");
+    ASSERT_FALSE(reducer.IsOverflow());
+}
+
+TEST(ReducerTestSuite, ProductPromotionTest) {
+    Reducer reducer(Reducer::Operation::kProduct);
+    std::vector<int> values = {kIntMax, kIntMax, kIntMax};
+    reducer.Add(values);
+    ASSERT_EQ(reducer.Result(), "9903520300447984150353281023");
+    ASSERT_FALSE(reducer.IsOverflow());
+
+    Reducer negative(Reducer::Operation::kProduct);
+    values = {kIntMin, kIntMin, kIntMin};
+    negative.Add(values);
+    ASSERT_EQ(negative.Result(), "-9903520314283042199192993792");
+    ASSERT_FALSE(negative.IsOverflow());
+}
+
+TEST(ReducerTestSuite, ProductOverflowTest) {
+    /* (2^31 - 1)^4 ещё помещается в int128, а (2^31 - 1)^5 уже нет */
+    Reducer reducer(Reducer::Operation::kProduct);
+    std::vector<int> values(4, kIntMax);
+    reducer.Add(values);
+    ASSERT_EQ(reducer.Result(), "21267647892944572736998860269687930881");
+    ASSERT_FALSE(reducer.IsOverflow());
+    values = {kIntMax};
+    reducer.Add(values);
+    ASSERT_TRUE(reducer.IsOverflow());
+}
+
+TEST(ReducerTestSuite, ProductZeroTest) {
+    Reducer reducer(Reducer::Operation::kProduct);
+    std::vector<int> values = {kIntMax, kIntMax, 0, kIntMax, kIntMax, kIntMax, kIntMax};
+    reducer.Add(values);
+    ASSERT_EQ(reducer.Result(), "0");
+    ASSERT_FALSE(reducer.IsOverflow());
+
+    /* Ноль после переполнения всё равно даёт 0, в том же вызове и в следующем */
+    Reducer late_zero(Reducer::Operation::kProduct);
+    values = {kIntMax, kIntMax, kIntMax, kIntMax, kIntMax, kIntMax, 0};
+    late_zero.Add(values);
+    ASSERT_EQ(late_zero.Result(), "0");
+    ASSERT_FALSE(late_zero.IsOverflow());
+
+    Reducer next_zero(Reducer::Operation::kProduct);
+    values.assign(6, kIntMax);
+    next_zero.Add(values);
+    ASSERT_TRUE(next_zero.IsOverflow());
+    values = {7, 0};
+    next_zero.Add(values);
+    ASSERT_EQ(next_zero.Result(), "0");
+    ASSERT_FALSE(next_zero.IsOverflow());
+    next_zero.Add(values);
+    ASSERT_EQ(next_zero.Result(), "0");
+}
+
+TEST(ReducerTestSuite, StreamTest) {
+    Reducer reducer(Reducer::Operation::kSum);
+    ASSERT_TRUE(ReduceText(" 1\n-2\t3  40\r\n", reducer));
+    ASSERT_EQ(reducer.Result(), "42");
+
+    Reducer incorrect(Reducer::Operation::kSum);
+    ASSERT_FALSE(ReduceText("1 2x 3", incorrect));
+    ASSERT_FALSE(ReduceText("99999999999", incorrect));
+}
+
+TEST(ReducerTestSuite, StreamBufferBoundaryTest) {
+    /*
+        Число 123456789 начинается за 4 байта до конца первого буфера
+        чтения и дочитывается только при следующем вызове fread
+    */
+    std::string text;
+    while(text.size() + 4 < kReadBufferSize) {
+        text += "1 ";
+    }
+    size_t ones = text.size() / 2;
+    text.resize(kReadBufferSize - 4, ' ');
+    text += "123456789 7";
+
+    Reducer reducer(Reducer::Operation::kSum);
+    ASSERT_TRUE(ReduceText(text, reducer));
+    ASSERT_EQ(reducer.Result(), std::to_string(ones + 123456789 + 7));
+
+    /* Значение длиннее буфера чтения считается ошибкой */
+    Reducer too_long(Reducer::Operation::kSum);
+    ASSERT_FALSE(ReduceText(std::string(kReadBufferSize + 1, '1'), too_long));
+}